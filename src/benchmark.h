@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Summary of a fixed length benchmark run, written as json or as key,value csv rows so results of
+// different commits can be compared by scripts.
+struct BenchmarkReport {
+    struct Bucket {
+        double begin;
+        double end;
+        uint32_t count;
+    };
+
+    // run configuration, escaped for the output format
+    std::vector<std::pair<std::string, std::string>> configuration;
+
+    uint32_t frames = 0;
+    double seconds = 0.0;
+    double framesPerSecond = 0.0;
+    double trianglesPerSecond = 0.0;
+    // frame times in ms
+    double min = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    std::vector<Bucket> histogram;
+
+    static constexpr uint32_t HISTOGRAM_BUCKETS = 20;
+
+    static BenchmarkReport fromFrameTimes(std::vector<double> frameTimes, double seconds, uint64_t trianglesPerFrame) {
+        BenchmarkReport report;
+        report.frames = static_cast<uint32_t>(frameTimes.size());
+        report.seconds = seconds;
+        if (frameTimes.empty()) {
+            return report;
+        }
+
+        std::sort(frameTimes.begin(), frameTimes.end());
+        auto percentile = [&frameTimes](double fraction) {
+            return frameTimes[std::min(frameTimes.size() - 1, static_cast<size_t>(fraction * frameTimes.size()))];
+        };
+
+        // a run shorter than the clock's resolution has no rate, and inf or nan isn't valid json
+        report.framesPerSecond = seconds > 0.0 ? frameTimes.size() / seconds : 0.0;
+        report.trianglesPerSecond = report.framesPerSecond * trianglesPerFrame;
+        report.min = frameTimes.front();
+        report.max = frameTimes.back();
+        for (double frameTime : frameTimes) {
+            report.mean += frameTime;
+        }
+        report.mean /= frameTimes.size();
+        report.median = percentile(0.5);
+        report.p95 = percentile(0.95);
+        report.p99 = percentile(0.99);
+
+        // equal width buckets from the fastest to the slowest frame
+        double bucketWidth = std::max((report.max - report.min) / HISTOGRAM_BUCKETS, 1e-6);
+        for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            report.histogram.push_back({report.min + i * bucketWidth, report.min + (i + 1) * bucketWidth, 0});
+        }
+        for (double frameTime : frameTimes) {
+            size_t bucket = std::min<size_t>(static_cast<size_t>((frameTime - report.min) / bucketWidth), HISTOGRAM_BUCKETS - 1);
+            ++report.histogram[bucket].count;
+        }
+
+        return report;
+    }
+
+    void writeJson(std::ostream& out) const {
+        std::streamsize precision = out.precision(6);
+        out << "{\n  \"configuration\": {";
+        for (size_t i = 0; i < configuration.size(); ++i) {
+            out << (i > 0 ? "," : "") << "\n    \"" << escapeJson(configuration[i].first) << "\": \"" << escapeJson(configuration[i].second) << "\"";
+        }
+        out << "\n  },\n"
+            << "  \"frames\": " << frames << ",\n"
+            << "  \"seconds\": " << seconds << ",\n"
+            << "  \"fps\": " << framesPerSecond << ",\n"
+            << "  \"triangles_per_second\": " << trianglesPerSecond << ",\n"
+            << "  \"frame_time_ms\": {\"min\": " << min << ", \"max\": " << max << ", \"mean\": " << mean
+            << ", \"median\": " << median << ", \"p95\": " << p95 << ", \"p99\": " << p99 << "},\n"
+            << "  \"histogram\": [";
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            out << (i > 0 ? "," : "") << "\n    {\"begin_ms\": " << histogram[i].begin << ", \"end_ms\": " << histogram[i].end
+                << ", \"count\": " << histogram[i].count << "}";
+        }
+        out << "\n  ]\n}\n";
+        out.precision(precision);
+    }
+
+    void writeCsv(std::ostream& out) const {
+        std::streamsize precision = out.precision(6);
+        out << "key,value\n";
+        for (const auto& entry : configuration) {
+            out << escapeCsv(entry.first) << "," << escapeCsv(entry.second) << "\n";
+        }
+        out << "frames," << frames << "\n"
+            << "seconds," << seconds << "\n"
+            << "fps," << framesPerSecond << "\n"
+            << "triangles_per_second," << trianglesPerSecond << "\n"
+            << "frame_time_min_ms," << min << "\n"
+            << "frame_time_max_ms," << max << "\n"
+            << "frame_time_mean_ms," << mean << "\n"
+            << "frame_time_median_ms," << median << "\n"
+            << "frame_time_p95_ms," << p95 << "\n"
+            << "frame_time_p99_ms," << p99 << "\n";
+        for (const auto& bucket : histogram) {
+            out << "histogram_" << bucket.begin << "_" << bucket.end << "_ms," << bucket.count << "\n";
+        }
+        out.precision(precision);
+    }
+
+    // device names and paths may contain quotes, backslashes or control characters
+    static std::string escapeJson(const std::string& value) {
+        std::string escaped;
+        for (char c : value) {
+            switch (c) {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\r':
+                escaped += "\\r";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char code[7];
+                    std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+            }
+        }
+        return escaped;
+    }
+
+    // quoted if it contains a separator, quote or line break, quotes doubled
+    static std::string escapeCsv(const std::string& value) {
+        if (value.find_first_of(",\"\r\n") == std::string::npos) {
+            return value;
+        }
+        std::string escaped = "\"";
+        for (char c : value) {
+            escaped += c;
+            if (c == '"') {
+                escaped += '"';
+            }
+        }
+        return escaped + "\"";
+    }
+};
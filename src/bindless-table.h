@@ -0,0 +1,218 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// Hands out indices below a fixed capacity, released indices are reused before new ones.
+class SlotAllocator {
+public:
+    void reset(uint32_t capacity) {
+        this->capacity = capacity;
+        next = 0;
+        freeSlots.clear();
+    }
+
+    uint32_t allocate() {
+        if (!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        if (next == capacity) {
+            throw std::runtime_error("bindless table full");
+        }
+        return next++;
+    }
+
+    void release(uint32_t slot) {
+        freeSlots.push_back(slot);
+    }
+
+    uint32_t getCapacity() const {
+        return capacity;
+    }
+
+    uint32_t getUsedCount() const {
+        return next - static_cast<uint32_t>(freeSlots.size());
+    }
+
+private:
+    uint32_t capacity = 0;
+    uint32_t next = 0;
+    std::vector<uint32_t> freeSlots;
+};
+
+// A single descriptor set holding large arrays of every sampled image and storage buffer the renderer uses,
+// with VK_EXT_descriptor_indexing. Shaders index the arrays with slots passed in push constants, so draws
+// never rebind sets. The arrays are partially bound, slots nothing was written to are never read, and update
+// after bind, slots may be written while command buffers using other slots are pending.
+// Not thread safe, and a slot may only be released or rewritten once no pending command buffer reads it.
+class BindlessTable {
+public:
+    static constexpr uint32_t IMAGE_BINDING = 0;
+    static constexpr uint32_t BUFFER_BINDING = 1;
+    // a single immutable sampler the images are read with
+    static constexpr uint32_t SAMPLER_BINDING = 2;
+
+    void init(VkDevice device, uint32_t imageCapacity, uint32_t bufferCapacity, VkSampler sampler, VkShaderStageFlags stages) {
+        this->device = device;
+        images.reset(imageCapacity);
+        buffers.reset(bufferCapacity);
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+        bindings[IMAGE_BINDING].binding = IMAGE_BINDING;
+        bindings[IMAGE_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        bindings[IMAGE_BINDING].descriptorCount = imageCapacity;
+        bindings[IMAGE_BINDING].stageFlags = stages;
+        bindings[BUFFER_BINDING].binding = BUFFER_BINDING;
+        bindings[BUFFER_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[BUFFER_BINDING].descriptorCount = bufferCapacity;
+        bindings[BUFFER_BINDING].stageFlags = stages;
+        bindings[SAMPLER_BINDING].binding = SAMPLER_BINDING;
+        bindings[SAMPLER_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        bindings[SAMPLER_BINDING].descriptorCount = 1;
+        bindings[SAMPLER_BINDING].stageFlags = stages;
+        bindings[SAMPLER_BINDING].pImmutableSamplers = &sampler;
+
+        const VkDescriptorBindingFlagsEXT arrayFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+            | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT
+            | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+        std::array<VkDescriptorBindingFlagsEXT, 3> bindingFlags = {arrayFlags, arrayFlags, 0};
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCreateInfo = {};
+        bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        bindingFlagsCreateInfo.bindingCount = bindingFlags.size();
+        bindingFlagsCreateInfo.pBindingFlags = bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+        descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+        descriptorSetLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        descriptorSetLayoutCreateInfo.bindingCount = bindings.size();
+        descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor set layout");
+        }
+
+        std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        poolSizes[0].descriptorCount = imageCapacity;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[1].descriptorCount = bufferCapacity;
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        poolSizes[2].descriptorCount = 1;
+
+        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+        descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        descriptorPoolCreateInfo.maxSets = 1;
+        descriptorPoolCreateInfo.poolSizeCount = poolSizes.size();
+        descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
+
+        if (vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor pool");
+        }
+
+        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+        descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocateInfo.descriptorPool = pool;
+        descriptorSetAllocateInfo.descriptorSetCount = 1;
+        descriptorSetAllocateInfo.pSetLayouts = &layout;
+
+        if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &set) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate bindless descriptor set");
+        }
+    }
+
+    void destroy() {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        pool = VK_NULL_HANDLE;
+        layout = VK_NULL_HANDLE;
+        set = VK_NULL_HANDLE;
+    }
+
+    VkDescriptorSetLayout getLayout() const {
+        return layout;
+    }
+
+    VkDescriptorSet getSet() const {
+        return set;
+    }
+
+    // the view is read in layout, usually VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    uint32_t addImage(VkImageView imageView, VkImageLayout imageLayout) {
+        uint32_t slot = images.allocate();
+        updateImage(slot, imageView, imageLayout);
+        return slot;
+    }
+
+    void updateImage(uint32_t slot, VkImageView imageView, VkImageLayout imageLayout) {
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageView = imageView;
+        imageInfo.imageLayout = imageLayout;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = IMAGE_BINDING;
+        write.dstArrayElement = slot;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+
+    void releaseImage(uint32_t slot) {
+        images.release(slot);
+    }
+
+    // offset must be a multiple of minStorageBufferOffsetAlignment
+    uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+        uint32_t slot = buffers.allocate();
+        updateBuffer(slot, buffer, offset, range);
+        return slot;
+    }
+
+    void updateBuffer(uint32_t slot, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+        VkDescriptorBufferInfo bufferInfo = {};
+        bufferInfo.buffer = buffer;
+        bufferInfo.offset = offset;
+        bufferInfo.range = range;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = BUFFER_BINDING;
+        write.dstArrayElement = slot;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+
+    void releaseBuffer(uint32_t slot) {
+        buffers.release(slot);
+    }
+
+    const SlotAllocator& getImageSlots() const {
+        return images;
+    }
+
+    const SlotAllocator& getBufferSlots() const {
+        return buffers;
+    }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    SlotAllocator images;
+    SlotAllocator buffers;
+};
@@ -0,0 +1,69 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// hello-triangle.vert with the object data read from the bindless table instead of bound per draw
+
+// the depth prepass and the equal tested pass have to compute bitwise identical depths
+out gl_PerVertex {
+    invariant vec4 gl_Position;
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 2) in vec2 instanceOffset;
+layout(location = 3) in float instanceScale;
+layout(location = 4) in float instanceRotation;
+layout(location = 5) in vec3 instanceColor;
+
+layout(location = 0) out vec3 outColor;
+layout(location = 1) out vec2 outTexCoord;
+// bindless image slot, the same for the whole triangle
+layout(location = 2) flat out uint outTexture;
+
+layout(set = 0, binding = 0) uniform Frame {
+    float time;
+    // slot of the buffer holding this frame's texture slots, instance i samples texture i % textureCount
+    uint textureBuffer;
+    uint textureCount;
+} frame;
+
+struct ObjectData {
+    vec4 color;
+    vec2 offset;
+    // radians per second
+    float spin;
+    // in [0, 1], nearer is smaller
+    float depth;
+};
+
+// every storage buffer in the bindless table, see bindless-table.h
+layout(set = 1, binding = 1) readonly buffer Objects {
+    ObjectData objects[];
+} buffers[];
+
+// the same binding seen as arrays of image slots
+layout(set = 1, binding = 1) readonly buffer TextureSlots {
+    uint slots[];
+} textureSlotBuffers[];
+
+layout(push_constant) uniform Push {
+    // slot of the buffer holding this frame's objects
+    uint objectBuffer;
+    uint objectIndex;
+} push;
+
+void main() {
+    ObjectData objectData = buffers[push.objectBuffer].objects[push.objectIndex];
+
+    float rotation = instanceRotation + objectData.spin * frame.time;
+    float s = sin(rotation);
+    float c = cos(rotation);
+    vec2 position = mat2(c, s, -s, c) * inPosition.xy * instanceScale + instanceOffset + objectData.offset;
+
+    gl_Position = vec4(position, objectData.depth, 1.0);
+    outColor = inColor * instanceColor * objectData.color.rgb;
+    outTexCoord = inPosition.xy + 0.5;
+    outTexture = frame.textureCount > 0 ? textureSlotBuffers[frame.textureBuffer].slots[gl_InstanceIndex % frame.textureCount] : 0;
+}
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "thread-pool.h"
+
+struct BoundingCircle {
+    float x;
+    float y;
+    float radius;
+};
+
+// points with dot(normal, p) + distance >= 0 are inside
+struct Plane2D {
+    float nx;
+    float ny;
+    float distance;
+};
+
+// Four wide bounding volume hierarchy over 2d objects for frustum culling. Objects are sorted along a
+// morton curve and grouped bottom up, so every subtree covers a contiguous range of the sorted objects
+// and culling produces a few ranges instead of a list of objects. The four children of a node are
+// tested against a plane at once.
+class Bvh {
+public:
+    struct Range {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    void build(const std::vector<BoundingCircle>& objects) {
+        nodes.clear();
+        order.clear();
+        if (objects.empty()) {
+            return;
+        }
+
+        sortByMortonCode(objects);
+
+        std::vector<ChildEntry> level(objects.size());
+        for (size_t i = 0; i < objects.size(); ++i) {
+            const BoundingCircle& object = objects[order[i]];
+            level[i] = {object.x - object.radius, object.y - object.radius, object.x + object.radius, object.y + object.radius,
+                        static_cast<uint32_t>(i), 1, OBJECT};
+        }
+
+        // children are created before their parents, the root is the last node
+        do {
+            std::vector<ChildEntry> parents;
+            parents.reserve((level.size() + WIDTH - 1) / WIDTH);
+            for (size_t i = 0; i < level.size(); i += WIDTH) {
+                Node node;
+                ChildEntry parent = {MAX, MAX, LOWEST, LOWEST, level[i].first, 0, static_cast<uint32_t>(nodes.size())};
+                for (uint32_t c = 0; c < WIDTH; ++c) {
+                    // empty slots have an inverted box and no objects
+                    ChildEntry child = i + c < level.size() ? level[i + c] : ChildEntry{MAX, MAX, LOWEST, LOWEST, 0, 0, OBJECT};
+                    node.minX[c] = child.minX;
+                    node.minY[c] = child.minY;
+                    node.maxX[c] = child.maxX;
+                    node.maxY[c] = child.maxY;
+                    node.first[c] = child.first;
+                    node.count[c] = child.count;
+                    node.child[c] = child.node;
+
+                    parent.minX = std::min(parent.minX, child.minX);
+                    parent.minY = std::min(parent.minY, child.minY);
+                    parent.maxX = std::max(parent.maxX, child.maxX);
+                    parent.maxY = std::max(parent.maxY, child.maxY);
+                    parent.count += child.count;
+                }
+                nodes.push_back(node);
+                parents.push_back(parent);
+            }
+            level = std::move(parents);
+        } while (level.size() > 1);
+    }
+
+    // position in morton order -> index of the object passed to build
+    const std::vector<uint32_t>& getOrder() const {
+        return order;
+    }
+
+    size_t getNodeCount() const {
+        return nodes.size();
+    }
+
+    // replaces visible with the visible objects as ranges of positions in morton order, adjacent ranges merged.
+    // the subtrees below the first few levels are culled on the thread pool if there is one
+    void cull(const std::vector<Plane2D>& planes, std::vector<Range>& visible, ThreadPool* threadPool = nullptr) const {
+        visible.clear();
+        if (nodes.empty()) {
+            return;
+        }
+        const uint32_t root = static_cast<uint32_t>(nodes.size() - 1);
+        if (threadPool == nullptr || threadPool->size() < 2) {
+            cullNode(root, planes, visible, std::numeric_limits<uint32_t>::max(), nullptr);
+            return;
+        }
+
+        // enough subtrees that uneven visibility still spreads across the threads
+        uint32_t splitDepth = 0;
+        for (size_t subtrees = 1; subtrees < threadPool->size() * 8; subtrees *= WIDTH) {
+            ++splitDepth;
+        }
+
+        // the top levels are culled here, leaving the subtrees below them as tasks in morton order
+        std::vector<Task> tasks;
+        cullNode(root, planes, visible, splitDepth, &tasks);
+
+        const size_t chunkCount = std::min(tasks.size(), threadPool->size());
+        const size_t tasksPerChunk = chunkCount > 0 ? (tasks.size() + chunkCount - 1) / chunkCount : 0;
+        std::vector<std::vector<Range>> chunkRanges(chunkCount);
+        std::vector<std::future<void>> culled;
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            const size_t begin = chunk * tasksPerChunk;
+            const size_t end = std::min(begin + tasksPerChunk, tasks.size());
+            std::vector<Range>& ranges = chunkRanges[chunk];
+            culled.push_back(threadPool->submit([this, &tasks, &planes, &ranges, begin, end]() {
+                for (size_t i = begin; i < end; ++i) {
+                    if (tasks[i].node == OBJECT) {
+                        append(ranges, tasks[i].range);
+                    } else {
+                        cullNode(tasks[i].node, planes, ranges, std::numeric_limits<uint32_t>::max(), nullptr);
+                    }
+                }
+            }));
+        }
+
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            // rethrows errors on the calling thread
+            culled[chunk].get();
+            for (const Range& range : chunkRanges[chunk]) {
+                append(visible, range);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t WIDTH = 4;
+    // child index of objects and empty slots
+    static constexpr uint32_t OBJECT = std::numeric_limits<uint32_t>::max();
+    // finite, so a zero plane normal component doesn't turn the distance into nan
+    static constexpr float MAX = std::numeric_limits<float>::max();
+    static constexpr float LOWEST = std::numeric_limits<float>::lowest();
+
+    // structure of arrays over the children, one load per component
+    struct alignas(16) Node {
+        float minX[WIDTH];
+        float minY[WIDTH];
+        float maxX[WIDTH];
+        float maxY[WIDTH];
+        // the sorted objects below each child, count 0 for empty slots
+        uint32_t first[WIDTH];
+        uint32_t count[WIDTH];
+        uint32_t child[WIDTH];
+    };
+
+    struct ChildEntry {
+        float minX;
+        float minY;
+        float maxX;
+        float maxY;
+        uint32_t first;
+        uint32_t count;
+        uint32_t node;
+    };
+
+    // a range decided above the split depth, or a subtree left to cull
+    struct Task {
+        uint32_t node;
+        Range range;
+    };
+
+    void sortByMortonCode(const std::vector<BoundingCircle>& objects) {
+        float minX = MAX, minY = MAX, maxX = LOWEST, maxY = LOWEST;
+        for (const BoundingCircle& object : objects) {
+            minX = std::min(minX, object.x);
+            minY = std::min(minY, object.y);
+            maxX = std::max(maxX, object.x);
+            maxY = std::max(maxY, object.y);
+        }
+        const float scaleX = maxX > minX ? 65535.0f / (maxX - minX) : 0.0f;
+        const float scaleY = maxY > minY ? 65535.0f / (maxY - minY) : 0.0f;
+
+        std::vector<std::pair<uint32_t, uint32_t>> codes(objects.size());
+        for (size_t i = 0; i < objects.size(); ++i) {
+            uint32_t x = static_cast<uint32_t>((objects[i].x - minX) * scaleX);
+            uint32_t y = static_cast<uint32_t>((objects[i].y - minY) * scaleY);
+            codes[i] = {spreadBits(x) | spreadBits(y) << 1, static_cast<uint32_t>(i)};
+        }
+        std::sort(codes.begin(), codes.end());
+
+        order.resize(objects.size());
+        for (size_t i = 0; i < codes.size(); ++i) {
+            order[i] = codes[i].second;
+        }
+    }
+
+    // inserts a zero bit above each of the low 16 bits
+    static uint32_t spreadBits(uint32_t value) {
+        value &= 0xffff;
+        value = (value | value << 8) & 0x00ff00ff;
+        value = (value | value << 4) & 0x0f0f0f0f;
+        value = (value | value << 2) & 0x33333333;
+        value = (value | value << 1) & 0x55555555;
+        return value;
+    }
+
+    static void append(std::vector<Range>& ranges, Range range) {
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == range.first) {
+            ranges.back().count += range.count;
+        } else {
+            ranges.push_back(range);
+        }
+    }
+
+    // bit c of outside is set if child c is outside a plane, bit c of intersecting if it isn't fully inside all of them
+    void classifyChildren(const Node& node, const std::vector<Plane2D>& planes, int& outside, int& intersecting) const {
+#ifdef BVH_SSE2
+        const __m128 minX = _mm_load_ps(node.minX);
+        const __m128 minY = _mm_load_ps(node.minY);
+        const __m128 maxX = _mm_load_ps(node.maxX);
+        const __m128 maxY = _mm_load_ps(node.maxY);
+        const __m128 zero = _mm_setzero_ps();
+
+        __m128 outsideMask = zero;
+        __m128 intersectingMask = zero;
+        for (const Plane2D& plane : planes) {
+            const __m128 nx = _mm_set1_ps(plane.nx);
+            const __m128 ny = _mm_set1_ps(plane.ny);
+            const __m128 distance = _mm_set1_ps(plane.distance);
+            // the corners furthest along and against the normal
+            const __m128 farX = plane.nx >= 0.0f ? maxX : minX;
+            const __m128 farY = plane.ny >= 0.0f ? maxY : minY;
+            const __m128 nearX = plane.nx >= 0.0f ? minX : maxX;
+            const __m128 nearY = plane.ny >= 0.0f ? minY : maxY;
+
+            __m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, farX), _mm_mul_ps(ny, farY)), distance);
+            __m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nearX), _mm_mul_ps(ny, nearY)), distance);
+            outsideMask = _mm_or_ps(outsideMask, _mm_cmplt_ps(farDistance, zero));
+            intersectingMask = _mm_or_ps(intersectingMask, _mm_cmplt_ps(nearDistance, zero));
+        }
+        outside = _mm_movemask_ps(outsideMask);
+        intersecting = _mm_movemask_ps(intersectingMask);
+#else
+        outside = 0;
+        intersecting = 0;
+        for (uint32_t c = 0; c < WIDTH; ++c) {
+            for (const Plane2D& plane : planes) {
+                float farX = plane.nx >= 0.0f ? node.maxX[c] : node.minX[c];
+                float farY = plane.ny >= 0.0f ? node.maxY[c] : node.minY[c];
+                float nearX = plane.nx >= 0.0f ? node.minX[c] : node.maxX[c];
+                float nearY = plane.ny >= 0.0f ? node.minY[c] : node.maxY[c];
+                if (plane.nx * farX + plane.ny * farY + plane.distance < 0.0f) {
+                    outside |= 1 << c;
+                }
+                if (plane.nx * nearX + plane.ny * nearY + plane.distance < 0.0f) {
+                    intersecting |= 1 << c;
+                }
+            }
+        }
+#endif
+    }
+
+    // subtrees at depth are deferred to tasks instead of culled, unless tasks is null
+    void cullNode(uint32_t nodeIndex, const std::vector<Plane2D>& planes, std::vector<Range>& visible, uint32_t depth, std::vector<Task>* tasks) const {
+        const Node& node = nodes[nodeIndex];
+        int outside, intersecting;
+        classifyChildren(node, planes, outside, intersecting);
+
+        for (uint32_t c = 0; c < WIDTH; ++c) {
+            if (node.count[c] == 0 || outside & (1 << c)) {
+                continue;
+            }
+            Range range = {node.first[c], node.count[c]};
+            // fully inside subtrees need no further tests
+            if (!(intersecting & (1 << c)) || node.child[c] == OBJECT) {
+                if (tasks != nullptr) {
+                    tasks->push_back({OBJECT, range});
+                } else {
+                    append(visible, range);
+                }
+            } else if (tasks != nullptr && depth <= 1) {
+                tasks->push_back({node.child[c], range});
+            } else {
+                cullNode(node.child[c], planes, visible, depth - 1, tasks);
+            }
+        }
+    }
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> order;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Draw order as a single integer. Draws are grouped by pipeline, then by material, so state changes are
+// rare, and ordered by depth within a group, front to back for opaque draws to make the most of early
+// depth testing, back to front for blended ones.
+//
+//  63        56 55                  32 31                    0
+//  |  pipeline  |       material      |         depth         |
+inline uint64_t makeDrawSortKey(uint32_t pipeline, uint32_t material, float depth, bool frontToBack) {
+    uint32_t depthBits;
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+    // flips negative floats entirely and sets the sign of positive ones, so the bits order like the values
+    depthBits = depthBits & 0x80000000u ? ~depthBits : depthBits | 0x80000000u;
+    if (!frontToBack) {
+        depthBits = ~depthBits;
+    }
+    return static_cast<uint64_t>(pipeline & 0xff) << 56 | static_cast<uint64_t>(material & 0xffffff) << 32 | depthBits;
+}
+
+// Sorts keys ascending and moves values along with them, a stable least significant digit radix sort over
+// bytes. All eight histograms are built in one pass, and passes over a byte every key shares are skipped,
+// which are most of them when a scene has few pipelines and materials.
+inline void radixSortDrawKeys(std::vector<uint64_t>& keys, std::vector<uint32_t>& values) {
+    const size_t count = keys.size();
+    if (count < 2) {
+        return;
+    }
+
+    std::array<std::array<uint32_t, 256>, 8> histograms = {};
+    for (uint64_t key : keys) {
+        for (uint32_t pass = 0; pass < 8; ++pass) {
+            ++histograms[pass][key >> (pass * 8) & 0xff];
+        }
+    }
+
+    std::vector<uint64_t> sortedKeys(count);
+    std::vector<uint32_t> sortedValues(count);
+    for (uint32_t pass = 0; pass < 8; ++pass) {
+        const uint32_t shift = pass * 8;
+        std::array<uint32_t, 256>& histogram = histograms[pass];
+        if (histogram[keys[0] >> shift & 0xff] == count) {
+            continue;
+        }
+
+        // counts to the position each digit's keys start at
+        uint32_t offset = 0;
+        for (uint32_t& bucket : histogram) {
+            uint32_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t destination = histogram[keys[i] >> shift & 0xff]++;
+            sortedKeys[destination] = keys[i];
+            sortedValues[destination] = values[i];
+        }
+        keys.swap(sortedKeys);
+        values.swap(sortedValues);
+    }
+}
@@ -1,63 +1,254 @@
 #include <algorithm>
 #include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
 #include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
 #include <set>
 #include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <vulkan/vulkan.h>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "benchmark.h"
+#include "bindless-table.h"
+#include "bvh.h"
+#include "draw-sort.h"
+#include "mapped-file.h"
+#include "memory-allocator.h"
+#include "mesh-file.h"
+#include "mesh.h"
+#include "obj-loader.h"
+#include "pipeline-compiler.h"
+#include "process-memory.h"
+#include "profiler.h"
+#include "ring-buffer.h"
+#include "shader-library.h"
+#include "texture-streamer.h"
+#include "thread-pool.h"
+#include "vertex-kernels.h"
+#include "vertex-layout.h"
+
+enum class PresentPolicy {
+    // tearing allowed, input sampled just before recording
+    LowestLatency,
+    // no tearing, the newest frame replaces queued ones where mailbox is available
+    LowLatency,
+    // no tearing, every frame is shown at the display rate, lowest power
+    Vsync,
+    // uncapped frame rate, latency doesn't matter
+    Throughput
+};
+
+// how each draw gets its object data in hello-triangle.vert
+enum class ObjectDataPath {
+    // pushed before every draw, nothing is written to memory
+    PushConstants,
+    // all objects in the frame's uniform buffer region, one descriptor set rebound at a dynamic offset per draw
+    DynamicUniform,
+    // all objects in the frame's uniform buffer region, a descriptor set per object allocated and written every frame
+    DescriptorSets,
+    // all objects in a storage buffer of the bindless table, the draw pushes the buffer slot and its object index
+    Bindless
+};
+
+// the order the objects' draws are recorded in
+enum class DrawOrder {
+    // object index order
+    Submission,
+    // nearest first, fragments behind what is already drawn fail the depth test before they are shaded
+    FrontToBack,
+    // farthest first, every layer is shaded, the worst case for opaque draws and the right order for blended ones
+    BackToFront
+};
+
+// per instance transform and tint, advanced once per instance instead of once per vertex
+struct Instance {
+    glm::vec2 offset;
+    float scale;
+    float rotation;
+    glm::vec3 color;
+};
+
+template<>
+struct VertexLayout<Instance> {
+    static constexpr std::array<VertexAttribute, 4> attributes = {{
+        {VK_FORMAT_R32G32_SFLOAT, offsetof(Instance, offset)},
+        {VK_FORMAT_R32_SFLOAT, offsetof(Instance, scale)},
+        {VK_FORMAT_R32_SFLOAT, offsetof(Instance, rotation)},
+        {VK_FORMAT_R32G32B32_SFLOAT, offsetof(Instance, color)}
+    }};
+};
+
+struct ApplicationOptions {
+    // render into offscreen images instead of a window surface, no display needed
+    bool headless = false;
+    // number of frames to render before exiting, 0 renders until the window is closed
+    uint32_t frameCount = 0;
+    // number of frames the cpu may record ahead of the gpu
+    uint32_t framesInFlight = 2;
+    // pipeline cache persisted across runs, empty disables it
+    std::string pipelineCachePath = "pipeline_cache.bin";
+    // draw calls recorded per frame, a synthetic scene for recording cost
+    uint32_t drawCount = 1;
+    // 0 records inline on the main thread, otherwise into this many secondary command buffers in parallel
+    uint32_t recordingThreads = 0;
+    // time command buffer recording for increasing thread counts instead of rendering
+    bool recordBenchmark = false;
+    // copies of the mesh drawn per draw call
+    uint32_t instanceCount = 1;
+    // report triangle throughput for increasing instance counts instead of rendering
+    bool instanceBenchmark = false;
+    // replaces the two triangles with a gridSize x gridSize quad grid in random triangle order, 0 disables it
+    uint32_t gridSize = 0;
+    // draws this mesh instead of the two triangles, an OBJ file parsed at startup or a mesh-converter file mapped
+    // and uploaded as is, empty disables it
+    std::string meshPath;
+    // print rolling cpu and gpu timings every second
+    bool profile = false;
+    // chrome trace event file written while profiling, empty disables it
+    std::string tracePath;
+    // render a fixed number of frames (frameCount) or seconds and report frame time statistics
+    bool benchmark = false;
+    double benchmarkSeconds = 0.0;
+    // .json or .csv report, empty only prints to the console
+    std::string benchmarkOutputPath;
+    // selects present mode, swapchain image count and frame pacing
+    PresentPolicy presentPolicy = PresentPolicy::LowLatency;
+    // present mode requested instead of the one the policy picks, if the surface supports it
+    bool presentModeOverride = false;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    // caps the frame rate by sleeping before input is sampled, 0 disables it
+    uint32_t fpsLimit = 0;
+    // draw the scene with a line polygon mode pipeline, compiled in the background
+    bool wireframe = false;
+    // time creating every pipeline permutation serially and on the worker pool instead of rendering
+    bool pipelineBenchmark = false;
+    // draw this many vertices animated on the cpu and streamed every frame instead of the mesh, 0 disables it
+    uint32_t streamVertexCount = 0;
+    // time the simd vertex packing kernels against a plain glm loop instead of rendering, needs no gpu
+    bool vertexKernelBenchmark = false;
+    // layout of the mesh and streamed vertices in gpu memory
+    VertexFormat vertexFormat = VertexFormat::Float;
+    // cull the instances in a compute shader and draw the visible ones with indirect draws, recording cost no
+    // longer depends on the object count
+    bool gpuCulling = false;
+    // cull the instances against the view on the cpu with a bvh and only record draws for the visible ones
+    bool cpuCulling = false;
+    // time bvh culling of instanceCount objects, a million by default, instead of rendering, needs no gpu
+    bool cullBenchmark = false;
+    // where the per draw object data comes from
+    ObjectDataPath objectDataPath = ObjectDataPath::PushConstants;
+    // render drawCount objects with every object data path and report cpu and frame times instead of rendering
+    bool descriptorBenchmark = false;
+    // procedural textures streamed in and sampled by the instances, needs the bindless object data path
+    uint32_t textureCount = 0;
+    // texels across the base level, a power of two
+    uint32_t textureSize = 1024;
+    // device memory the resident texture levels may use, lowered to what VK_EXT_memory_budget reports as left
+    uint32_t textureBudgetMiB = 256;
+    // order of the objects' draws, sorted by a key of pipeline, material and depth
+    DrawOrder drawOrder = DrawOrder::FrontToBack;
+    // lay down every draw's depth in a depth only pass first, so the shading pass only runs the fragment shader
+    // for the nearest object of a pixel whatever the draw order. the instances of an object share its depth and
+    // all of them pass the equal test where they overlap, so it needs a draw per object and a single instance.
+    bool depthPrepass = false;
+    // render drawCount overlapping objects with and without depth testing, sorting and the prepass and report
+    // frame times and fragment shader invocations instead of rendering
+    bool depthBenchmark = false;
+};
+
 class HelloTriangleApplication {
 public:
+    explicit HelloTriangleApplication(const ApplicationOptions& options) : options(options) {}
+
     void run() {
-        initWindow();
+        if (options.vertexKernelBenchmark) {
+            runVertexKernelBenchmark();
+            return;
+        }
+        if (options.cullBenchmark) {
+            runCullBenchmark();
+            return;
+        }
+        if (!options.headless) {
+            initWindow();
+        }
         initVulkan();
-        mainLoop();
+        if (options.recordBenchmark) {
+            runRecordingBenchmark();
+        } else if (options.instanceBenchmark) {
+            runInstanceBenchmark();
+        } else if (options.benchmark) {
+            runBenchmark();
+        } else if (options.pipelineBenchmark) {
+            runPipelineBenchmark();
+        } else if (options.descriptorBenchmark) {
+            runDescriptorBenchmark();
+        } else if (options.depthBenchmark) {
+            runDepthBenchmark();
+        } else {
+            mainLoop();
+        }
         cleanup();
     }
 
 private:
+    const ApplicationOptions options;
+
     const uint32_t WIDTH = 800;
     const uint32_t HEIGHT = 600;
 
-    struct Vertex {
-        glm::vec2 position;
-        glm::vec3 color;
-
-        static const VkVertexInputBindingDescription getVertexInputBindingDescription() {
-            VkVertexInputBindingDescription vertexInputBindingDescription = {};
-            vertexInputBindingDescription.binding = 0;
-            vertexInputBindingDescription.stride = sizeof(Vertex);
-            vertexInputBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-            return vertexInputBindingDescription;
-        }
-
-        static const std::array<VkVertexInputAttributeDescription, 2> getVertexInputAttributeDescriptions() {
-            std::array<VkVertexInputAttributeDescription, 2> vertexInputAttributeDescriptions = {};
-
-            vertexInputAttributeDescriptions[0].binding = 0;
-            vertexInputAttributeDescriptions[0].location = 0;
-            vertexInputAttributeDescriptions[0].offset = offsetof(Vertex, position);
-            vertexInputAttributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-
-            vertexInputAttributeDescriptions[1].binding = 0;
-            vertexInputAttributeDescriptions[1].location = 1;
-            vertexInputAttributeDescriptions[1].offset = offsetof(Vertex, color);
-            vertexInputAttributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-
-            return vertexInputAttributeDescriptions;
-        }
-    };
-
-    const std::vector<Vertex> vertices = {
+    const uint32_t DEFAULT_HEADLESS_FRAME_COUNT = 1000;
+    // longer than any display interval
+    const uint64_t PRESENT_WAIT_TIMEOUT_NS = 100000000;
+    const uint32_t RECORDING_BENCHMARK_ITERATIONS = 20;
+    const uint32_t DEFAULT_INSTANCE_BENCHMARK_MAX_INSTANCES = 1000000;
+    const uint32_t INSTANCE_BENCHMARK_FRAMES = 100;
+    // fits the profiler's sample window
+    const uint32_t DESCRIPTOR_BENCHMARK_FRAMES = 200;
+    const uint32_t DEPTH_BENCHMARK_FRAMES = 200;
+    // bindless table size, lowered to the device limits
+    const uint32_t BINDLESS_IMAGE_CAPACITY = 16384;
+    const uint32_t BINDLESS_BUFFER_CAPACITY = 4096;
+    // raised to the base level size, at least one level is uploaded per frame
+    const VkDeviceSize TEXTURE_UPLOAD_BYTES_PER_FRAME = 4 * 1024 * 1024;
+    // not measured, they include pipeline and driver warm up
+    const uint32_t BENCHMARK_WARMUP_FRAMES = 10;
+    // streaming buffer space per frame if nothing is streamed that needs more
+    const VkDeviceSize DEFAULT_STREAMING_BYTES_PER_FRAME = 1024 * 1024;
+    const size_t VERTEX_KERNEL_BENCHMARK_VERTICES = 4 * 1024 * 1024;
+    // best of, the first run also pays for page faults in the output
+    const uint32_t VERTEX_KERNEL_BENCHMARK_ITERATIONS = 10;
+    // objects are spread over this many view widths, so culling has something to reject
+    const float CULLING_WORLD_SCALE = 3.0f;
+    const uint32_t DEFAULT_CULL_BENCHMARK_OBJECTS = 1000000;
+    const uint32_t CULL_BENCHMARK_ITERATIONS = 20;
+    // local_size_x of cull.comp
+    const uint32_t CULLING_WORKGROUP_SIZE = 64;
+    // the draw count lives in front of the commands, padded to 16 bytes
+    static constexpr VkDeviceSize DRAW_COMMANDS_OFFSET = 16;
+    const uint32_t PARALLEL_CULLING_MIN_OBJECTS = 65536;
+
+    // imported as an unindexed triangle list like most exporters write it
+    const std::vector<Vertex> triangleVertices = {
         {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
         {{-0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}},
         {{0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}},
@@ -70,6 +261,7 @@ private:
         "VK_LAYER_LUNARG_standard_validation"
     };
 
+    // also required in headless mode, the render pass transitions to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
     const std::vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
@@ -83,12 +275,109 @@ private:
     struct QueueFamilyIndices {
         int graphicsFamily = -1;
         int presentFamily = -1;
+        // a transfer-only family if the device has one, the graphics family otherwise
+        int transferFamily = -1;
+        // a compute family without graphics if the device has one, so culling runs on an async compute queue,
+        // the graphics family otherwise
+        int computeFamily = -1;
 
         bool isComplete() {
             return graphicsFamily >= 0 && presentFamily >= 0;
         }
     };
 
+    // one pool per job, so parallel jobs never touch the same pool
+    struct RecordingJob {
+        VkCommandPool commandPool;
+        VkCommandBuffer commandBuffer;
+        // the job's draws of the depth prepass, every job's are executed before any job shades
+        VkCommandBuffer prepassCommandBuffer;
+    };
+
+    struct FrameResources {
+        VkSemaphore imageAcquiredSemaphore;
+        VkSemaphore renderingFinishedSemaphore;
+        // signaled once the gpu is done with the frame's command buffer
+        VkFence inFlightFence;
+        VkCommandBuffer commandBuffer;
+        std::vector<RecordingJob> recordingJobs;
+        // number of the last frame submitted with these resources
+        uint64_t submittedFrame = 0;
+        // begin and end of the render pass, written while profiling if the queue supports timestamps
+        uint32_t firstTimestampQuery = 0;
+        // fragment shader invocations of the render pass, for the depth benchmark
+        uint32_t statisticsQuery = 0;
+        bool timestampsRecorded = false;
+        bool timestampsPending = false;
+        Profiler::Clock::time_point submitTime;
+        // gpu culling, recorded and submitted on the compute queue ahead of the frame's draws
+        VkCommandBuffer cullingCommandBuffer = VK_NULL_HANDLE;
+        VkSemaphore cullingFinishedSemaphore = VK_NULL_HANDLE;
+        VkDescriptorSet cullingDescriptorSet = VK_NULL_HANDLE;
+        // draw count followed by one VkDrawIndexedIndirectCommand per object
+        VkBuffer drawBuffer = VK_NULL_HANDLE;
+        Allocation drawBufferAllocation;
+        // the draw count copied back for statistics
+        VkBuffer drawCountReadbackBuffer = VK_NULL_HANDLE;
+        Allocation drawCountReadbackAllocation;
+        // reset every frame, holds the object descriptor sets of ObjectDataPath::DescriptorSets
+        VkDescriptorPool objectDescriptorPool = VK_NULL_HANDLE;
+        // bindless table slot pointed at the frame's objects with ObjectDataPath::Bindless
+        uint32_t objectBufferSlot = 0;
+        // bindless table slot pointed at the frame's texture slots
+        uint32_t textureBufferSlot = 0;
+    };
+
+    // bounding circle of an object, matches ObjectBounds in cull.comp
+    struct ObjectBounds {
+        glm::vec2 center;
+        float radius;
+        float padding;
+    };
+
+    // matches Frame in bindless.vert, hello-triangle.vert only reads the time
+    struct FrameUniforms {
+        float time;
+        uint32_t textureBuffer;
+        uint32_t textureCount;
+        float padding;
+    };
+
+    // matches ObjectData in hello-triangle.vert
+    struct ObjectData {
+        glm::vec4 color;
+        glm::vec2 offset;
+        float spin;
+        // in [0, 1], nearer is smaller
+        float depth;
+    };
+
+    // matches the push constants in hello-triangle.vert
+    struct ObjectPushConstants {
+        ObjectData object;
+        uint32_t objectSource;
+    };
+
+    // matches the push constants in bindless.vert
+    struct BindlessPushConstants {
+        uint32_t objectBuffer;
+        uint32_t objectIndex;
+    };
+
+    // matches the push constants in cull.comp
+    struct CullingConstants {
+        glm::vec4 planes[4];
+        uint32_t objectCount;
+        uint32_t indexCount;
+        uint32_t compact;
+    };
+
+    struct DeferredDestruction {
+        // the resources may be destroyed once this frame has completed on the gpu
+        uint64_t retireFrame;
+        std::function<void()> destroy;
+    };
+
     struct SwapChainCapabilities {
         VkSurfaceCapabilitiesKHR surfaceCapabilities;
         std::vector<VkSurfaceFormatKHR> surfaceFormats;
@@ -112,19 +401,70 @@ private:
     void initVulkan() {
         createVkInstance();
         createDebugCallback();
-        createWindowSurface();
+        if (!options.headless) {
+            createWindowSurface();
+        }
         selectPhysicalDevice();
         createLogicalDevice();
+        allocator.init(physicalDevice, device);
+        workerPool = std::make_unique<ThreadPool>();
+        profiler.setEnabled(options.profile || !options.tracePath.empty());
+        if (!options.tracePath.empty()) {
+            profiler.openTrace(options.tracePath);
+        }
+        createPipelineCache();
         createShaders();
-        createSwapChain();
+        if (options.headless) {
+            createOffscreenImages();
+        } else {
+            createSwapChain();
+        }
         createImageViews();
+        depthFormat = chooseDepthFormat();
+        createDepthImage();
         createRenderPass();
+        createDescriptorSetLayouts();
+        if (bindlessSupported) {
+            createBindlessTable();
+        }
         createGraphicsPipeline();
+        createPipelineCompiler();
+        if (options.gpuCulling) {
+            createCullingPipeline();
+        }
         createFramebuffers();
         createCommandPool();
+        loadMesh();
         createVertexBuffer();
-        createCommandBuffers();
-        createSemaphores();
+        createIndexBuffer();
+        if (!options.meshPath.empty()) {
+            printMeshLoadStats();
+        }
+        createInstanceBuffer(options.instanceCount);
+        // the culling paths and --draw-calls 0 still bind the first object
+        generateObjectData(std::max(options.drawCount, 1u));
+        sortDraws(options.drawOrder);
+        createStreamingBuffer();
+        createFrameResources();
+        createDescriptorSets();
+        if (options.textureCount > 0) {
+            createTextures();
+        }
+        if (options.gpuCulling) {
+            createCullingResources();
+        }
+        createTimestampQueryPool();
+        if (pipelineStatisticsSupported) {
+            createStatisticsQueryPool();
+        }
+        printMemoryStats();
+    }
+
+    void printMemoryStats() {
+        MemoryAllocator::Stats stats = allocator.getStats();
+        std::cout << "device memory: " << stats.usedBytes << " of " << stats.blockBytes << " bytes used by "
+                  << stats.allocationCount << " allocations in " << stats.blockCount << " blocks, fragmentation "
+                  << stats.fragmentation << std::endl;
     }
 
     void recreateSwapchain() {
@@ -134,16 +474,62 @@ private:
             return;
         }
 
-        vkDeviceWaitIdle(device);
-
-        cleanupSwapchain();
-
+        auto start = std::chrono::steady_clock::now();
+
+        // frames in flight may still render to the retired swapchain, its image views and framebuffers
+        // are destroyed once those frames have completed instead of draining the gpu. the frame fences don't
+        // cover the presents queued on it, the swapchain itself is only destroyed once those are done too.
+        VkSwapchainKHR retiredSwapchain = swapchain;
+        std::vector<VkImageView> retiredImageViews = std::move(swapChainImageViews);
+        std::vector<VkFramebuffer> retiredFramebuffers = std::move(swapChainFramebuffers);
+        VkImage retiredDepthImage = depthImage;
+        VkImageView retiredDepthImageView = depthImageView;
+        Allocation retiredDepthImageAllocation = depthImageAllocation;
+        deferDestruction([this, retiredSwapchain, retiredImageViews, retiredFramebuffers, retiredDepthImage, retiredDepthImageView, retiredDepthImageAllocation]() mutable {
+            for (const auto& framebuffer : retiredFramebuffers) {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+            for (const auto& imageView : retiredImageViews) {
+                vkDestroyImageView(device, imageView, nullptr);
+            }
+            vkDestroyImageView(device, retiredDepthImageView, nullptr);
+            vkDestroyImage(device, retiredDepthImage, nullptr);
+            allocator.free(retiredDepthImageAllocation);
+            retireSwapchain(retiredSwapchain);
+        });
+
+        VkFormat previousImageFormat = swapChainImageFormat;
+        // hands the retired swapchain over as oldSwapchain
         createSwapChain();
         createImageViews();
-        createRenderPass();
-        createGraphicsPipeline();
+        createDepthImage();
+        // viewport and scissor are dynamic, the render pass and pipeline only depend on the image formats
+        if (swapChainImageFormat != previousImageFormat) {
+            // permutations are compiled against the render pass too, none may be in flight while it is replaced
+            for (VkPipeline retiredPermutation : pipelineCompiler.release()) {
+                deferDestruction([this, retiredPermutation]() {
+                    vkDestroyPipeline(device, retiredPermutation, nullptr);
+                });
+            }
+            VkPipeline retiredPipeline = pipeline;
+            VkPipelineLayout retiredPipelineLayout = pipelineLayout;
+            VkRenderPass retiredRenderPass = renderPass;
+            deferDestruction([this, retiredPipeline, retiredPipelineLayout, retiredRenderPass]() {
+                vkDestroyPipeline(device, retiredPipeline, nullptr);
+                vkDestroyPipelineLayout(device, retiredPipelineLayout, nullptr);
+                vkDestroyRenderPass(device, retiredRenderPass, nullptr);
+            });
+            createRenderPass();
+            createGraphicsPipeline();
+            pipelineCompiler.request(sceneKey);
+        }
         createFramebuffers();
-        createCommandBuffers();
+        if (options.textureCount > 0) {
+            updateTextureDemand();
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "swapchain recreated in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
     }
 
     void createVkInstance() {
@@ -166,6 +552,18 @@ private:
         if (!checkExtensions(requiredExtensions)) {
             std::cout << "missing extension" << std::endl;
         }
+        // extended feature and property queries, descriptor indexing is only reported through them
+        physicalDeviceProperties2Supported = checkExtensions({VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME});
+        if (physicalDeviceProperties2Supported) {
+            requiredExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        }
+        // needed by VK_EXT_swapchain_maintenance1's present fences
+        surfaceMaintenance1Supported = !options.headless && physicalDeviceProperties2Supported
+            && checkExtensions({VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME, VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME});
+        if (surfaceMaintenance1Supported) {
+            requiredExtensions.push_back(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
+            requiredExtensions.push_back(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+        }
 
         createInfo.enabledExtensionCount = requiredExtensions.size();
         createInfo.ppEnabledExtensionNames = requiredExtensions.data();
@@ -206,11 +604,14 @@ private:
     }
 
     std::vector<const char*> getRequiredExtensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        std::vector<const char*> extensions;
 
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        if (!options.headless) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
@@ -299,6 +700,9 @@ private:
     bool isDeviceSuitable(const VkPhysicalDevice& device) {
         QueueFamilyIndices indices = findQueueFamilyIndices(device);
         bool extensionsSupported = checkSupportedDeviceExtensions(device);
+        if (options.headless) {
+            return indices.isComplete() && extensionsSupported;
+        }
         SwapChainCapabilities swapChainCapabilities = querySwapChainCapabilities(device);
         return indices.isComplete()
             && extensionsSupported
@@ -316,13 +720,19 @@ private:
 
         for (uint32_t i = 0; i < queueFamilyCount; ++i) {
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR( device, i, surface, &presentSupport);
+            if (!options.headless) {
+                vkGetPhysicalDeviceSurfaceSupportKHR( device, i, surface, &presentSupport);
+            }
             if (properties[i].queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
             }
 
             if (properties[i].queueCount > 0 && properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 indices.graphicsFamily = i;
+                // nothing is presented in headless mode, the graphics queue stands in for the present queue
+                if (options.headless) {
+                    indices.presentFamily = i;
+                }
             }
 
             if (indices.isComplete()) {
@@ -330,9 +740,44 @@ private:
             }
         }
 
+        indices.transferFamily = indices.graphicsFamily;
+        for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+            // dedicated transfer queues map to the copy engines of discrete gpus
+            if (properties[i].queueCount > 0
+                && properties[i].queueFlags & VK_QUEUE_TRANSFER_BIT
+                && !(properties[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                indices.transferFamily = i;
+                break;
+            }
+        }
+
+        indices.computeFamily = indices.graphicsFamily;
+        for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+            if (properties[i].queueCount > 0
+                && properties[i].queueFlags & VK_QUEUE_COMPUTE_BIT
+                && !(properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.computeFamily = i;
+                break;
+            }
+        }
+
         return indices;
     }
 
+    bool isDeviceExtensionSupported(const VkPhysicalDevice& device, const char* extension) {
+        uint32_t extensionPropertyCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionPropertyCount, nullptr);
+        std::vector<VkExtensionProperties> extensionProperties(extensionPropertyCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionPropertyCount, extensionProperties.data());
+
+        for (const auto& extensionProperty : extensionProperties) {
+            if (strcmp(extensionProperty.extensionName, extension) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     bool checkSupportedDeviceExtensions(const VkPhysicalDevice& device) {
         uint32_t extensionPropertyCount;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionPropertyCount, nullptr);
@@ -393,17 +838,96 @@ private:
     }
 
     VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& supportedModes) {
-        for (const auto& mode : supportedModes) {
-            if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                return mode;
-            } else if (mode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+        if (options.presentModeOverride) {
+            if (std::find(supportedModes.begin(), supportedModes.end(), options.presentMode) != supportedModes.end()) {
+                return options.presentMode;
+            }
+            std::cerr << "present mode " << presentModeName(options.presentMode) << " not supported, using the present policy" << std::endl;
+        }
+
+        // in order of preference, independent of the order the driver reports the modes in
+        std::vector<VkPresentModeKHR> preferredModes;
+        switch (options.presentPolicy) {
+        case PresentPolicy::LowestLatency:
+        case PresentPolicy::Throughput:
+            preferredModes = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+            break;
+        case PresentPolicy::LowLatency:
+            preferredModes = {VK_PRESENT_MODE_MAILBOX_KHR};
+            break;
+        case PresentPolicy::Vsync:
+            break;
+        }
+
+        for (const auto& mode : preferredModes) {
+            if (std::find(supportedModes.begin(), supportedModes.end(), mode) != supportedModes.end()) {
                 return mode;
             }
         }
-        // fallback option
+        // fallback option, always supported
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
+    uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities, VkPresentModeKHR presentMode) {
+        uint32_t imageCount = capabilities.minImageCount + 1;
+        if (options.presentPolicy == PresentPolicy::LowestLatency) {
+            // every additional image is a frame that may wait in the queue
+            imageCount = std::max(capabilities.minImageCount, 2u);
+        } else if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR || options.presentPolicy == PresentPolicy::Throughput) {
+            // one image on screen, one queued and one to render into, so rendering never waits for the display
+            imageCount = std::max(imageCount, 3u);
+        }
+
+        if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+            imageCount = capabilities.maxImageCount;
+        }
+        return imageCount;
+    }
+
+    // with fifo the cpu would otherwise run ahead until every swapchain image and frame in flight is queued,
+    // each of them adding a display interval between sampling input and showing the result
+    bool needsFramePacing(VkPresentModeKHR presentMode) const {
+        switch (options.presentPolicy) {
+        case PresentPolicy::LowestLatency:
+        case PresentPolicy::Vsync:
+            return true;
+        case PresentPolicy::LowLatency:
+            return presentMode == VK_PRESENT_MODE_FIFO_KHR || presentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+        case PresentPolicy::Throughput:
+            return false;
+        }
+        return false;
+    }
+
+    static const char* presentPolicyName(PresentPolicy presentPolicy) {
+        switch (presentPolicy) {
+        case PresentPolicy::LowestLatency:
+            return "lowest-latency";
+        case PresentPolicy::LowLatency:
+            return "low-latency";
+        case PresentPolicy::Vsync:
+            return "vsync";
+        case PresentPolicy::Throughput:
+            return "throughput";
+        }
+        return "unknown";
+    }
+
+    static const char* presentModeName(VkPresentModeKHR presentMode) {
+        switch (presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "fifo-relaxed";
+        default:
+            return "unknown";
+        }
+    }
+
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
         if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
             return capabilities.currentExtent;
@@ -420,27 +944,125 @@ private:
     void createLogicalDevice() {
         QueueFamilyIndices indices = findQueueFamilyIndices(physicalDevice);
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<int> uniqueQueueFamilyIndices = {indices.graphicsFamily, indices.presentFamily};
+        std::set<int> uniqueQueueFamilyIndices = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily, indices.computeFamily};
 
+        // read by vkCreateDevice, has to outlive the loop
+        const float queuePriority = 1.0f;
         for (auto index : uniqueQueueFamilyIndices) {
             VkDeviceQueueCreateInfo queueCreateInfo = {};
             queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
             queueCreateInfo.queueFamilyIndex = index;
             queueCreateInfo.queueCount = 1;
-            float queuePriority = 1.0f;
             queueCreateInfo.pQueuePriorities = &queuePriority;
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
+        // line polygon mode for --wireframe and pipeline permutations
+        deviceFeatures.fillModeNonSolid = supportedFeatures.fillModeNonSolid;
+        fillModeNonSolidSupported = supportedFeatures.fillModeNonSolid == VK_TRUE;
+        // fragment shader invocations for the depth benchmark
+        // secondary command buffers executed while the query is active need inherited queries
+        const bool inheritedQueriesNeeded = options.recordingThreads > 0;
+        pipelineStatisticsSupported = options.depthBenchmark && supportedFeatures.pipelineStatisticsQuery == VK_TRUE
+            && (!inheritedQueriesNeeded || supportedFeatures.inheritedQueries == VK_TRUE);
+        deviceFeatures.pipelineStatisticsQuery = pipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+        deviceFeatures.inheritedQueries = pipelineStatisticsSupported && inheritedQueriesNeeded ? VK_TRUE : VK_FALSE;
+
+        std::vector<const char*> enabledExtensions = deviceExtensions;
+        bool drawIndirectCountSupported = false;
+        if (options.gpuCulling) {
+            // one indirect draw per object needs firstInstance to select the object's instance data
+            if (!supportedFeatures.drawIndirectFirstInstance) {
+                throw std::runtime_error("gpu culling needs the drawIndirectFirstInstance feature");
+            }
+            deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+            deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+            multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
+            // lets the gpu decide how many of the commands are drawn, so culled objects cost nothing
+            drawIndirectCountSupported = isDeviceExtensionSupported(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            if (drawIndirectCountSupported) {
+                enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            }
+        }
+
+        // the bindless table is created whenever the device can index descriptors
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {};
+        bindlessSupported = getBindlessFeatures(descriptorIndexingFeatures);
+        if (options.textureCount > 0 && (!bindlessSupported || !descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing)) {
+            throw std::runtime_error("--textures needs VK_EXT_descriptor_indexing with non uniform indexing of sampled images");
+        }
+        if (bindlessSupported) {
+            enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        } else if (options.objectDataPath == ObjectDataPath::Bindless) {
+            throw std::runtime_error("--object-data bindless needs VK_EXT_descriptor_indexing with update after bind storage buffers and sampled images");
+        }
+
+        // the texture budget follows what the rest of the system leaves of device memory
+        memoryBudgetSupported = options.textureCount > 0 && physicalDeviceProperties2Supported
+            && isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (memoryBudgetSupported) {
+            enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            vkGetPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+        }
+
+        // signals a fence once the presentation engine is done with a present, so retired swapchains can be
+        // destroyed without idling the queue
+        VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenance1Features = {};
+        swapchainMaintenance1Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+        swapchainMaintenance1Supported = surfaceMaintenance1Supported
+            && isDeviceExtensionSupported(physicalDevice, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME)
+            && getSwapchainMaintenance1Feature();
+        if (swapchainMaintenance1Supported) {
+            enabledExtensions.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+            swapchainMaintenance1Features.swapchainMaintenance1 = VK_TRUE;
+        }
+
+        // lets frame pacing wait for presents to reach the display instead of for the gpu
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitSupported = !options.headless && physicalDeviceProperties2Supported
+            && isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+            && isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)
+            && getPresentWaitFeatures();
+        if (presentWaitSupported) {
+            enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+            presentIdFeatures.presentId = VK_TRUE;
+            presentWaitFeatures.presentWait = VK_TRUE;
+        }
+
+        // the feature structs of every enabled extension
+        void* enabledFeatures = nullptr;
+        if (bindlessSupported) {
+            descriptorIndexingFeatures.pNext = enabledFeatures;
+            enabledFeatures = &descriptorIndexingFeatures;
+        }
+        if (swapchainMaintenance1Supported) {
+            swapchainMaintenance1Features.pNext = enabledFeatures;
+            enabledFeatures = &swapchainMaintenance1Features;
+        }
+        if (presentWaitSupported) {
+            presentIdFeatures.pNext = enabledFeatures;
+            presentWaitFeatures.pNext = &presentIdFeatures;
+            enabledFeatures = &presentWaitFeatures;
+        }
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = enabledFeatures;
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.queueCreateInfoCount = queueCreateInfos.size();
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
-        createInfo.enabledExtensionCount = deviceExtensions.size();
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
+        createInfo.enabledExtensionCount = enabledExtensions.size();
 
         if (enableValidationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -455,25 +1077,206 @@ private:
 
         vkGetDeviceQueue( device, indices.graphicsFamily, 0, &graphicsQueue);
         vkGetDeviceQueue( device, indices.presentFamily, 0, &presentQueue);
+        vkGetDeviceQueue( device, indices.transferFamily, 0, &transferQueue);
+        vkGetDeviceQueue( device, indices.computeFamily, 0, &computeQueue);
+
+        if (drawIndirectCountSupported) {
+            vkCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+        }
+        if (presentWaitSupported) {
+            vkWaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+        }
+    }
+
+    bool getSwapchainMaintenance1Feature() {
+        auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+        VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT supported = {};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &supported;
+        getPhysicalDeviceFeatures2(physicalDevice, &features);
+        return supported.swapchainMaintenance1 == VK_TRUE;
+    }
+
+    bool getPresentWaitFeatures() {
+        auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.pNext = &presentIdFeatures;
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &presentWaitFeatures;
+        getPhysicalDeviceFeatures2(physicalDevice, &features);
+        return presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
     }
 
+    // fills enabled with the descriptor indexing features the bindless table needs, false if any is missing
+    bool getBindlessFeatures(VkPhysicalDeviceDescriptorIndexingFeaturesEXT& enabled) {
+        if (!physicalDeviceProperties2Supported
+            || !isDeviceExtensionSupported(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+            || !isDeviceExtensionSupported(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+            return false;
+        }
+
+        auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &supported;
+        getPhysicalDeviceFeatures2(physicalDevice, &features);
+
+        if (!supported.runtimeDescriptorArray
+            || !supported.descriptorBindingPartiallyBound
+            || !supported.descriptorBindingUpdateUnusedWhilePending
+            || !supported.descriptorBindingSampledImageUpdateAfterBind
+            || !supported.descriptorBindingStorageBufferUpdateAfterBind) {
+            return false;
+        }
+
+        enabled = {};
+        enabled.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        enabled.runtimeDescriptorArray = VK_TRUE;
+        enabled.descriptorBindingPartiallyBound = VK_TRUE;
+        enabled.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        enabled.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        enabled.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        // lets fragment shaders pick a different image per pixel
+        enabled.shaderSampledImageArrayNonUniformIndexing = supported.shaderSampledImageArrayNonUniformIndexing;
+        return true;
+    }
+
+    // only starts loading, the swapchain is created in the meantime and the pipeline waits for the modules
     void createShaders() {
-        auto vertexShaderCode = readFile("vert.spv");
-        auto fragmentShaderCode = readFile("frag.spv");
-        vertexShaderModule = createShaderModule(vertexShaderCode);
-        fragmentShaderModule = createShaderModule(fragmentShaderCode);
+        shaderLibrary.init(device, *workerPool);
+        vertexShaderModule = shaderLibrary.load("vert.spv");
+        fragmentShaderModule = shaderLibrary.load("frag.spv");
+        // needs descriptor indexing, so it is only loaded if it may be used
+        if (bindlessSupported && (options.objectDataPath == ObjectDataPath::Bindless || options.descriptorBenchmark)) {
+            bindlessVertexShaderModule = shaderLibrary.load("bindless.spv");
+        }
+        if (options.textureCount > 0) {
+            texturedFragmentShaderModule = shaderLibrary.load("textured.spv");
+        }
+        if (options.gpuCulling) {
+            cullingShaderModule = shaderLibrary.load("cull.spv");
+        }
+    }
+
+    // prefixed to the serialized cache data, the driver's own cache header lacks the driver version
+    struct PipelineCacheFileHeader {
+        uint32_t magic;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    static const uint32_t PIPELINE_CACHE_FILE_MAGIC = 0x50434348; // "PCCH"
+
+    void createPipelineCache() {
+        std::vector<char> cacheData = loadPipelineCacheData();
+        pipelineCacheWarm = !cacheData.empty();
+
+        VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+        pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+        pipelineCacheCreateInfo.pInitialData = cacheData.data();
+
+        if (vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache");
+        }
+    }
+
+    // returns no data if there is no cache file or it was written by a different device or driver
+    std::vector<char> loadPipelineCacheData() {
+        if (options.pipelineCachePath.empty()) {
+            return {};
+        }
+
+        std::ifstream fileStream(options.pipelineCachePath, std::ios::binary);
+        if (!fileStream.is_open()) {
+            return {};
+        }
+
+        PipelineCacheFileHeader header;
+        if (!fileStream.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            return {};
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        if (header.magic != PIPELINE_CACHE_FILE_MAGIC
+            || header.vendorID != properties.vendorID
+            || header.deviceID != properties.deviceID
+            || header.driverVersion != properties.driverVersion
+            || memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            std::cout << "discarding pipeline cache " << options.pipelineCachePath << " from a different device or driver" << std::endl;
+            return {};
+        }
+
+        // a truncated or corrupt file must not size the allocation
+        const std::streamoff dataOffset = fileStream.tellg();
+        fileStream.seekg(0, std::ios::end);
+        const std::streamoff fileSize = fileStream.tellg();
+        if (dataOffset < 0 || fileSize < dataOffset || header.dataSize > static_cast<uint64_t>(fileSize - dataOffset)) {
+            std::cout << "discarding truncated pipeline cache " << options.pipelineCachePath << std::endl;
+            return {};
+        }
+        fileStream.seekg(dataOffset);
+
+        std::vector<char> cacheData(header.dataSize);
+        if (!fileStream.read(cacheData.data(), cacheData.size())) {
+            return {};
+        }
+        return cacheData;
+    }
+
+    void savePipelineCache() {
+        if (options.pipelineCachePath.empty()) {
+            return;
+        }
+
+        size_t dataSize;
+        vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr);
+        std::vector<char> cacheData(dataSize);
+        if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS) {
+            std::cerr << "failed to get pipeline cache data" << std::endl;
+            return;
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        PipelineCacheFileHeader header = {};
+        header.magic = PIPELINE_CACHE_FILE_MAGIC;
+        header.vendorID = properties.vendorID;
+        header.deviceID = properties.deviceID;
+        header.driverVersion = properties.driverVersion;
+        memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        header.dataSize = dataSize;
+
+        std::ofstream fileStream(options.pipelineCachePath, std::ios::binary | std::ios::trunc);
+        fileStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fileStream.write(cacheData.data(), dataSize);
+        if (!fileStream) {
+            std::cerr << "failed to write pipeline cache " << options.pipelineCachePath << std::endl;
+        }
     }
 
     void createSwapChain() {
         SwapChainCapabilities swapChainCapabilities = querySwapChainCapabilities(physicalDevice);
         VkSurfaceFormatKHR surfaceFormat = chooseSurfaceFormat(swapChainCapabilities.surfaceFormats);
-        VkPresentModeKHR presentMode = choosePresentMode(swapChainCapabilities.presentModes);
+        presentMode = choosePresentMode(swapChainCapabilities.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainCapabilities.surfaceCapabilities);
 
-        uint32_t imageCount = swapChainCapabilities.surfaceCapabilities.minImageCount + 1;
-        if (swapChainCapabilities.surfaceCapabilities.maxImageCount > 0 && imageCount > swapChainCapabilities.surfaceCapabilities.maxImageCount) {
-            imageCount = swapChainCapabilities.surfaceCapabilities.maxImageCount;
-        }
+        uint32_t imageCount = chooseImageCount(swapChainCapabilities.surfaceCapabilities, presentMode);
+        framePacing = needsFramePacing(presentMode);
 
         VkSwapchainCreateInfoKHR swapChainCreateInfo = {};
         swapChainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -503,7 +1306,8 @@ private:
         swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         swapChainCreateInfo.presentMode = presentMode;
         swapChainCreateInfo.clipped = VK_TRUE;
-        swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+        // lets the driver reuse resources of the retired swapchain and keeps presenting it until the switch
+        swapChainCreateInfo.oldSwapchain = swapchain;
 
         if (vkCreateSwapchainKHR(device, &swapChainCreateInfo, nullptr, &swapchain) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create swapchain");
@@ -512,11 +1316,47 @@ private:
         vkGetSwapchainImagesKHR(device, swapchain, &imageCount, nullptr);
         swapChainImages.resize(imageCount);
         vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapChainImages.data());
+        presentedImages.assign(imageCount, false);
+
+        if (swapChainCreateInfo.oldSwapchain == VK_NULL_HANDLE) {
+            std::cout << "present policy " << presentPolicyName(options.presentPolicy) << ": " << presentModeName(presentMode)
+                      << ", " << imageCount << " swapchain images, frame pacing " << (framePacing ? "on" : "off") << std::endl;
+        }
 
         swapChainImageFormat = surfaceFormat.format;
         swapChainExtent = extent;
     }
 
+    void createOffscreenImages() {
+        // stand-ins for the swapchain images, rendered into but never presented
+        swapChainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+        swapChainExtent = {WIDTH, HEIGHT};
+        // one image per frame in flight, so the frame's fence also guards its image
+        swapChainImages.resize(options.framesInFlight);
+        offscreenImageAllocations.resize(options.framesInFlight);
+
+        for (size_t i = 0; i < swapChainImages.size(); ++i) {
+            VkImageCreateInfo imageCreateInfo = {};
+            imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = swapChainImageFormat;
+            imageCreateInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+            imageCreateInfo.mipLevels = 1;
+            imageCreateInfo.arrayLayers = 1;
+            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            if (vkCreateImage(device, &imageCreateInfo, nullptr, &swapChainImages[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create offscreen image");
+            }
+
+            offscreenImageAllocations[i] = allocator.allocateImage(swapChainImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+    }
+
     void createImageViews() {
         swapChainImageViews.resize(swapChainImages.size());
         for (size_t i = 0; i < swapChainImages.size(); ++i) {
@@ -541,6 +1381,57 @@ private:
         }
     }
 
+    // the first format the device can render depth to, float precision preferred, stencil isn't used
+    VkFormat chooseDepthFormat() {
+        for (VkFormat format : {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D16_UNORM}) {
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+            if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+                return format;
+            }
+        }
+        throw std::runtime_error("failed to find a supported depth format");
+    }
+
+    // a single depth image shared by every framebuffer, the render pass dependency orders its use across frames
+    void createDepthImage() {
+        VkImageCreateInfo imageCreateInfo = {};
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = depthFormat;
+        imageCreateInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // cleared at the start of the render pass and never stored, tilers can keep it on chip
+        imageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(device, &imageCreateInfo, nullptr, &depthImage) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth image");
+        }
+        depthImageAllocation = allocator.allocateImage(depthImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkImageViewCreateInfo imageViewCreateInfo = {};
+        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        imageViewCreateInfo.image = depthImage;
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.format = depthFormat;
+        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        // attachment views of combined formats need both aspects
+        if (depthFormat == VK_FORMAT_D24_UNORM_S8_UINT || depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT) {
+            imageViewCreateInfo.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+        imageViewCreateInfo.subresourceRange.levelCount = 1;
+        imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device, &imageViewCreateInfo, nullptr, &depthImageView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth image view");
+        }
+    }
+
     void createRenderPass() {
         VkAttachmentDescription colorAttachment = {};
         colorAttachment.format = swapChainImageFormat;
@@ -552,28 +1443,49 @@ private:
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+        VkAttachmentDescription depthAttachment = {};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+
         VkAttachmentReference colorAttachmentRef = {};
         colorAttachmentRef.attachment = 0;
         colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+        VkAttachmentReference depthAttachmentRef = {};
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
         VkSubpassDescription subpassDesc = {};
         subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         subpassDesc.colorAttachmentCount = 1;
         subpassDesc.pColorAttachments = &colorAttachmentRef;
+        subpassDesc.pDepthStencilAttachment = &depthAttachmentRef;
 
         VkSubpassDependency subpassDependency = {};
         subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
         // index of only subpass there is currently
         subpassDependency.dstSubpass = 0;
-        subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpassDependency.srcAccessMask = 0;
-        subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        // the previous frame's depth tests have to be done with the shared depth image before it is cleared,
+        // depth is written by the early tests too
+        subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+            | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subpassDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+            | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
         VkRenderPassCreateInfo renderPassCreateInfo = {};
         renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassCreateInfo.attachmentCount = 1;
-        renderPassCreateInfo.pAttachments = &colorAttachment;
+        renderPassCreateInfo.attachmentCount = attachments.size();
+        renderPassCreateInfo.pAttachments = attachments.data();
         renderPassCreateInfo.subpassCount = 1;
         renderPassCreateInfo.pSubpasses = &subpassDesc;
         renderPassCreateInfo.dependencyCount = 1;
@@ -584,17 +1496,164 @@ private:
         }
     }
 
+    // set 0 holds the frame uniforms, set 1 the object uniforms, both at dynamic offsets into the streaming buffer
+    void createDescriptorSetLayouts() {
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+        descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCreateInfo.bindingCount = 1;
+        descriptorSetLayoutCreateInfo.pBindings = &binding;
+
+        if (vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &frameDescriptorSetLayout) != VK_SUCCESS
+            || vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &objectDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layouts");
+        }
+    }
+
+    void createBindlessTable() {
+        auto getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingProperties = {};
+        descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &descriptorIndexingProperties;
+        getPhysicalDeviceProperties2(physicalDevice, &properties);
+
+        uint32_t imageCapacity = std::min({BINDLESS_IMAGE_CAPACITY,
+            descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+        uint32_t bufferCapacity = std::min({BINDLESS_BUFFER_CAPACITY,
+            descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+            descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers});
+        // both arrays, the sampler and the frame uniforms also share one per stage budget, split it in the
+        // ratio of the requested capacities
+        const uint32_t reservedResources = 2;
+        const uint32_t resourceBudget = descriptorIndexingProperties.maxPerStageUpdateAfterBindResources > reservedResources + 2
+            ? descriptorIndexingProperties.maxPerStageUpdateAfterBindResources - reservedResources : 2;
+        if (uint64_t(imageCapacity) + bufferCapacity > resourceBudget) {
+            const uint64_t scaledImages = uint64_t(resourceBudget) * imageCapacity / (uint64_t(imageCapacity) + bufferCapacity);
+            imageCapacity = static_cast<uint32_t>(std::max<uint64_t>(scaledImages, 1));
+            bufferCapacity = std::min(bufferCapacity, std::max(resourceBudget - imageCapacity, 1u));
+        }
+
+        VkSamplerCreateInfo samplerCreateInfo = {};
+        samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+        samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+        samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        if (vkCreateSampler(device, &samplerCreateInfo, nullptr, &bindlessSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless sampler");
+        }
+
+        bindlessTable.init(device, imageCapacity, bufferCapacity, bindlessSampler, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+        std::cout << "bindless table with " << imageCapacity << " image and " << bufferCapacity << " buffer slots" << std::endl;
+    }
+
     void createGraphicsPipeline() {
+        // the bindless shader reads the objects from the table instead of set 1
+        const bool bindless = objectDataPath == ObjectDataPath::Bindless;
+        std::array<VkDescriptorSetLayout, 2> setLayouts = {frameDescriptorSetLayout, bindless ? bindlessTable.getLayout() : objectDescriptorSetLayout};
+
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = bindless ? sizeof(BindlessPushConstants) : sizeof(ObjectPushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+        pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCreateInfo.setLayoutCount = setLayouts.size();
+        pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout");
+        }
+
+        // the default permutation, also the fallback while others are compiled
+        auto start = std::chrono::steady_clock::now();
+        pipeline = createPipeline(PipelineKey(), pipelineCache);
+        auto end = std::chrono::steady_clock::now();
+
+        std::cout << "graphics pipeline created in " << std::chrono::duration<double, std::milli>(end - start).count()
+                  << " ms (" << (pipelineCacheWarm ? "warm" : "cold") << " pipeline cache)" << std::endl;
+        // any later creation hits the entries this one added
+        pipelineCacheWarm = true;
+    }
+
+    void createCullingPipeline() {
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+        // object bounds
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[0].descriptorCount = 1;
+        bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        // draw count and commands
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[1].descriptorCount = 1;
+        bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+        descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCreateInfo.bindingCount = bindings.size();
+        descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &cullingDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling descriptor set layout");
+        }
+
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullingConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+        pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCreateInfo.setLayoutCount = 1;
+        pipelineLayoutCreateInfo.pSetLayouts = &cullingDescriptorSetLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &cullingPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling pipeline layout");
+        }
+
+        VkComputePipelineCreateInfo computePipelineCreateInfo = {};
+        computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        computePipelineCreateInfo.stage.module = cullingShaderModule.get();
+        computePipelineCreateInfo.stage.pName = "main";
+        computePipelineCreateInfo.layout = cullingPipelineLayout;
+
+        if (vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &cullingPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling pipeline");
+        }
+    }
+
+    // reads shader modules, layout and render pass, so it may run on any thread as long as they don't change
+    VkPipeline createPipeline(const PipelineKey& key, VkPipelineCache cache) {
         VkPipelineShaderStageCreateInfo vertexStageCreateInfo = {};
         vertexStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         vertexStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertexStageCreateInfo.module = vertexShaderModule;
+        vertexStageCreateInfo.module = objectDataPath == ObjectDataPath::Bindless ? bindlessVertexShaderModule.get() : vertexShaderModule.get();
         vertexStageCreateInfo.pName = "main";
 
         VkPipelineShaderStageCreateInfo fragmentStageCreateInfo = {};
         fragmentStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         fragmentStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragmentStageCreateInfo.module = fragmentShaderModule;
+        fragmentStageCreateInfo.module = options.textureCount > 0 ? texturedFragmentShaderModule.get() : fragmentShaderModule.get();
         fragmentStageCreateInfo.pName = "main";
 
         VkPipelineShaderStageCreateInfo shaderStages[] = {
@@ -602,46 +1661,51 @@ private:
             fragmentStageCreateInfo
         };
 
-        auto vertexAttributeDescriptions = Vertex::getVertexInputAttributeDescriptions();
-        auto vertexInputBindingDescription = Vertex::getVertexInputBindingDescription();
+        // binding 0 holds the mesh vertices, binding 1 the instances
+        std::vector<VkVertexInputBindingDescription> vertexInputBindingDescriptions;
+        std::vector<VkVertexInputAttributeDescription> vertexAttributeDescriptions;
+        uint32_t instanceLocation = withVertexType([&](auto vertex) {
+            using GpuVertex = decltype(vertex);
+            vertexInputBindingDescriptions.push_back(getVertexBindingDescription<GpuVertex>(0, VK_VERTEX_INPUT_RATE_VERTEX));
+            return appendVertexAttributeDescriptions<GpuVertex>(0, 0, vertexAttributeDescriptions);
+        });
+        vertexInputBindingDescriptions.push_back(getVertexBindingDescription<Instance>(1, VK_VERTEX_INPUT_RATE_INSTANCE));
+        appendVertexAttributeDescriptions<Instance>(1, instanceLocation, vertexAttributeDescriptions);
         VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
         vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
         vertexInputStateCreateInfo.vertexAttributeDescriptionCount = vertexAttributeDescriptions.size();
         vertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexAttributeDescriptions.data();
-        vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-        vertexInputStateCreateInfo.pVertexBindingDescriptions = &vertexInputBindingDescription;
+        vertexInputStateCreateInfo.vertexBindingDescriptionCount = vertexInputBindingDescriptions.size();
+        vertexInputStateCreateInfo.pVertexBindingDescriptions = vertexInputBindingDescriptions.data();
 
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {};
         inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        inputAssemblyStateCreateInfo.topology = key.topology;
         inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
 
-        VkViewport viewport = {};
-        viewport.x = 0;
-        viewport.y = 0;
-        viewport.width = WIDTH;
-        viewport.height = HEIGHT;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        VkRect2D scissor = {};
-        scissor.extent = swapChainExtent;
-        scissor.offset = {0, 0};
-
+        // set when recording, so the pipeline survives swapchain resizes
         VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
         viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportStateCreateInfo.viewportCount = 1;
-        viewportStateCreateInfo.pViewports = &viewport;
         viewportStateCreateInfo.scissorCount = 1;
-        viewportStateCreateInfo.pScissors = &scissor;
+
+        VkDynamicState dynamicStates[] = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR
+        };
+
+        VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
+        dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicStateCreateInfo.dynamicStateCount = sizeof(dynamicStates)/sizeof(dynamicStates[0]);
+        dynamicStateCreateInfo.pDynamicStates = dynamicStates;
 
         VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo = {};
         rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
         rasterizationStateCreateInfo.depthClampEnable = VK_FALSE;
         rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-        rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizationStateCreateInfo.polygonMode = key.polygonMode;
         rasterizationStateCreateInfo.lineWidth = 1.0f;
-        rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+        rasterizationStateCreateInfo.cullMode = key.cullMode;
         rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
         rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE;
 
@@ -650,13 +1714,59 @@ private:
         multisampleStateCreateInfo.sampleShadingEnable = VK_FALSE;
         multisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
+        VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo = {};
+        depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        switch (key.depthMode) {
+        case DepthMode::Off:
+            depthStencilStateCreateInfo.depthTestEnable = VK_FALSE;
+            depthStencilStateCreateInfo.depthWriteEnable = VK_FALSE;
+            break;
+        case DepthMode::TestAndWrite:
+        case DepthMode::Prepass:
+            // instances of an object share its depth, later ones still win like without a depth test
+            depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+            depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+            depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+            break;
+        case DepthMode::Equal:
+            depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+            depthStencilStateCreateInfo.depthWriteEnable = VK_FALSE;
+            depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+            break;
+        }
+
         VkPipelineColorBlendAttachmentState colorBlendAttachmentState = {};
         colorBlendAttachmentState.colorWriteMask =
             VK_COLOR_COMPONENT_R_BIT
             | VK_COLOR_COMPONENT_G_BIT
             | VK_COLOR_COMPONENT_B_BIT
             | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachmentState.blendEnable = VK_FALSE;
+        if (key.depthMode == DepthMode::Prepass) {
+            colorBlendAttachmentState.colorWriteMask = 0;
+        }
+        switch (key.blendMode) {
+        case BlendMode::Opaque:
+            colorBlendAttachmentState.blendEnable = VK_FALSE;
+            break;
+        case BlendMode::Alpha:
+            colorBlendAttachmentState.blendEnable = VK_TRUE;
+            colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+            colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+            break;
+        case BlendMode::Additive:
+            colorBlendAttachmentState.blendEnable = VK_TRUE;
+            colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+            colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+            break;
+        }
 
         VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {};
         colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -664,201 +1774,2422 @@ private:
         colorBlendStateCreateInfo.attachmentCount = 1;
         colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
 
-        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
-        pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+        pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        // the prepass has no fragment shader, there is nothing to shade
+        pipelineCreateInfo.stageCount = key.depthMode == DepthMode::Prepass ? 1 : sizeof(shaderStages)/sizeof(shaderStages[0]);
+        pipelineCreateInfo.pStages = shaderStages;
+        pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
+        pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
+        pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+        pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
+        pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
+        pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
+        pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
+        pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+        pipelineCreateInfo.layout = pipelineLayout;
+        pipelineCreateInfo.renderPass = renderPass;
+        pipelineCreateInfo.subpass = 0;
+
+        VkPipeline pipeline;
+        if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create graphics pipeline");
+        }
+        return pipeline;
+    }
+
+    void createPipelineCompiler() {
+        pipelineCompiler.init(device, *workerPool, [this](const PipelineKey& key) {
+            try {
+                return createPipeline(key, pipelineCache);
+            } catch (const std::exception& exception) {
+                std::cerr << exception.what() << ", staying on the fallback pipeline" << std::endl;
+                throw;
+            }
+        });
+
+        if (options.wireframe) {
+            if (fillModeNonSolidSupported) {
+                sceneKey.polygonMode = VK_POLYGON_MODE_LINE;
+            } else {
+                std::cerr << "device doesn't support fillModeNonSolid, ignoring --wireframe" << std::endl;
+            }
+        }
+        // drawn with the default pipeline until it is compiled
+        pipelineCompiler.request(sceneKey);
+        activePipeline = pipeline;
+    }
+
+    // every combination of the key's fields the device supports
+    // only permutations that can be drawn: the vertex shaders don't write gl_PointSize, so no points, and
+    // the depth only prepass has no color output to blend
+    std::vector<PipelineKey> enumeratePipelineKeys() const {
+        std::vector<VkPolygonMode> polygonModes = {VK_POLYGON_MODE_FILL};
+        if (fillModeNonSolidSupported) {
+            polygonModes.push_back(VK_POLYGON_MODE_LINE);
+        }
+
+        std::vector<PipelineKey> keys;
+        for (VkPrimitiveTopology topology : {VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, VK_PRIMITIVE_TOPOLOGY_LINE_LIST}) {
+            for (VkPolygonMode polygonMode : polygonModes) {
+                for (VkCullModeFlags cullMode : {VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_AND_BACK}) {
+                    for (BlendMode blendMode : {BlendMode::Opaque, BlendMode::Alpha, BlendMode::Additive}) {
+                        for (DepthMode depthMode : {DepthMode::Off, DepthMode::TestAndWrite, DepthMode::Prepass, DepthMode::Equal}) {
+                            if (depthMode == DepthMode::Prepass && blendMode != BlendMode::Opaque) {
+                                continue;
+                            }
+                            PipelineKey key;
+                            key.topology = topology;
+                            key.polygonMode = polygonMode;
+                            key.cullMode = cullMode;
+                            key.blendMode = blendMode;
+                            key.depthMode = depthMode;
+                            keys.push_back(key);
+                        }
+                    }
+                }
+            }
+        }
+        return keys;
+    }
+
+    void runPipelineBenchmark() {
+        std::vector<PipelineKey> keys = enumeratePipelineKeys();
+
+        // each run starts from an empty cache, otherwise the second one would only measure cache hits
+        auto createEmptyCache = [this]() {
+            VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+            pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+            VkPipelineCache cache;
+            if (vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &cache) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline cache");
+            }
+            return cache;
+        };
+
+        VkPipelineCache serialCache = createEmptyCache();
+        std::vector<VkPipeline> serialPipelines;
+        auto serialStart = std::chrono::steady_clock::now();
+        for (const auto& key : keys) {
+            serialPipelines.push_back(createPipeline(key, serialCache));
+        }
+        auto serialEnd = std::chrono::steady_clock::now();
+
+        VkPipelineCache parallelCache = createEmptyCache();
+        PipelineCompiler parallelCompiler;
+        parallelCompiler.init(device, *workerPool, [this, parallelCache](const PipelineKey& key) {
+            return createPipeline(key, parallelCache);
+        });
+        auto parallelStart = std::chrono::steady_clock::now();
+        // every key twice, the duplicates must not cost a second compilation
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const auto& key : keys) {
+                parallelCompiler.request(key);
+            }
+        }
+        for (const auto& key : keys) {
+            parallelCompiler.wait(key);
+        }
+        auto parallelEnd = std::chrono::steady_clock::now();
+
+        double serialMilliseconds = std::chrono::duration<double, std::milli>(serialEnd - serialStart).count();
+        double parallelMilliseconds = std::chrono::duration<double, std::milli>(parallelEnd - parallelStart).count();
+        std::cout << keys.size() << " pipeline permutations, cold caches" << std::endl;
+        std::cout << "serial:   " << serialMilliseconds << " ms" << std::endl;
+        std::cout << "parallel: " << parallelMilliseconds << " ms on " << workerPool->size() << " threads ("
+                  << serialMilliseconds / parallelMilliseconds << "x)" << std::endl;
+
+        for (VkPipeline serialPipeline : serialPipelines) {
+            vkDestroyPipeline(device, serialPipeline, nullptr);
+        }
+        parallelCompiler.destroy();
+        vkDestroyPipelineCache(device, serialCache, nullptr);
+        vkDestroyPipelineCache(device, parallelCache, nullptr);
+    }
+
+    template<typename Function>
+    double bestMilliseconds(Function&& function) {
+        double best = std::numeric_limits<double>::max();
+        for (uint32_t i = 0; i < VERTEX_KERNEL_BENCHMARK_ITERATIONS; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    void runVertexKernelBenchmark() {
+        const size_t count = VERTEX_KERNEL_BENCHMARK_VERTICES;
+
+        // the same vertices as structure of arrays for the kernels and as glm structs for the baseline
+        struct GlmVertex {
+            glm::vec2 position;
+            glm::vec4 color;
+        };
+        std::vector<GlmVertex> glmVertices(count);
+        VertexStream stream;
+        stream.resize(count);
+
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> color(0.0f, 1.0f);
+        for (size_t i = 0; i < count; ++i) {
+            glmVertices[i] = {{position(random), position(random)}, {color(random), color(random), color(random), 1.0f}};
+            stream.x[i] = glmVertices[i].position.x;
+            stream.y[i] = glmVertices[i].position.y;
+            stream.r[i] = glmVertices[i].color.x;
+            stream.g[i] = glmVertices[i].color.y;
+            stream.b[i] = glmVertices[i].color.z;
+            stream.a[i] = glmVertices[i].color.w;
+        }
+
+        const float angle = 0.3f;
+        Transform2D transform;
+        transform.m00 = std::cos(angle);
+        transform.m01 = -std::sin(angle);
+        transform.m10 = std::sin(angle);
+        transform.m11 = std::cos(angle);
+        transform.tx = 0.25f;
+        transform.ty = -0.5f;
+
+        glm::mat4 matrix(1.0f);
+        matrix[0][0] = transform.m00;
+        matrix[0][1] = transform.m10;
+        matrix[1][0] = transform.m01;
+        matrix[1][1] = transform.m11;
+        matrix[3][0] = transform.tx;
+        matrix[3][1] = transform.ty;
+
+        std::vector<PackedVertex> packed(count);
+        std::vector<PackedVertex> packedReference(count);
+        std::vector<HalfVertex> half(count);
+        std::vector<HalfVertex> halfReference(count);
+
+        auto report = [count](const char* name, double milliseconds, double baselineMilliseconds) {
+            std::cout << "  " << name << ": " << milliseconds << " ms, "
+                      << count / milliseconds / 1000.0 << " Mvertices/s ("
+                      << baselineMilliseconds / milliseconds << "x)" << std::endl;
+        };
+
+        const SimdLevel supported = detectSimdLevel();
+        std::cout << count << " vertices, best of " << VERTEX_KERNEL_BENCHMARK_ITERATIONS
+                  << " runs, cpu supports " << simdLevelName(supported) << std::endl;
+
+        std::cout << "float positions, rgba8 colors" << std::endl;
+        double glmMilliseconds = bestMilliseconds([&]() {
+            for (size_t i = 0; i < count; ++i) {
+                glm::vec4 transformed = matrix * glm::vec4(glmVertices[i].position, 0.0f, 1.0f);
+                packed[i] = {transformed.x, transformed.y, glm::packUnorm4x8(glmVertices[i].color)};
+            }
+        });
+        report("glm", glmMilliseconds, glmMilliseconds);
+
+        packVertices(stream, transform, packedReference.data(), SimdLevel::Scalar);
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2}) {
+            if (level > supported) {
+                break;
+            }
+            report(simdLevelName(level), bestMilliseconds([&]() { packVertices(stream, transform, packed.data(), level); }), glmMilliseconds);
+            if (memcmp(packed.data(), packedReference.data(), count * sizeof(PackedVertex)) != 0) {
+                throw std::runtime_error(std::string(simdLevelName(level)) + " kernel output differs from the scalar kernel");
+            }
+        }
+
+        std::cout << "half positions, rgba8 colors" << std::endl;
+        glmMilliseconds = bestMilliseconds([&]() {
+            for (size_t i = 0; i < count; ++i) {
+                glm::vec4 transformed = matrix * glm::vec4(glmVertices[i].position, 0.0f, 1.0f);
+                uint32_t position = glm::packHalf2x16(glm::vec2(transformed.x, transformed.y));
+                half[i] = {static_cast<uint16_t>(position), static_cast<uint16_t>(position >> 16), glm::packUnorm4x8(glmVertices[i].color)};
+            }
+        });
+        report("glm", glmMilliseconds, glmMilliseconds);
+
+        packVertices(stream, transform, halfReference.data(), SimdLevel::Scalar);
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2}) {
+            if (level > supported) {
+                break;
+            }
+            report(simdLevelName(level), bestMilliseconds([&]() { packVertices(stream, transform, half.data(), level); }), glmMilliseconds);
+            if (memcmp(half.data(), halfReference.data(), count * sizeof(HalfVertex)) != 0) {
+                throw std::runtime_error(std::string(simdLevelName(level)) + " kernel output differs from the scalar kernel");
+            }
+        }
+
+        std::cout << "snorm positions, rgba8 colors" << std::endl;
+        std::vector<SnormVertex> snorm(count);
+        std::vector<SnormVertex> snormReference(count);
+        glmMilliseconds = bestMilliseconds([&]() {
+            for (size_t i = 0; i < count; ++i) {
+                glm::vec4 transformed = matrix * glm::vec4(glmVertices[i].position, 0.0f, 1.0f);
+                uint32_t position = glm::packSnorm2x16(glm::vec2(transformed.x, transformed.y));
+                snorm[i] = {static_cast<int16_t>(position & 0xffff), static_cast<int16_t>(position >> 16), glm::packUnorm4x8(glmVertices[i].color)};
+            }
+        });
+        report("glm", glmMilliseconds, glmMilliseconds);
+
+        packVertices(stream, transform, snormReference.data(), SimdLevel::Scalar);
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse2}) {
+            if (level > supported) {
+                break;
+            }
+            report(simdLevelName(level), bestMilliseconds([&]() { packVertices(stream, transform, snorm.data(), level); }), glmMilliseconds);
+            if (memcmp(snorm.data(), snormReference.data(), count * sizeof(SnormVertex)) != 0) {
+                throw std::runtime_error(std::string(simdLevelName(level)) + " kernel output differs from the scalar kernel");
+            }
+        }
+    }
+
+    void createFramebuffers() {
+        swapChainFramebuffers.resize(swapChainImageViews.size());
+
+        for (size_t i = 0; i < swapChainImageViews.size(); ++i) {
+            std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageView};
+
+            VkFramebufferCreateInfo framebufferCreateInfo = {};
+            framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferCreateInfo.attachmentCount = attachments.size();
+            framebufferCreateInfo.pAttachments = attachments.data();
+            framebufferCreateInfo.renderPass = renderPass;
+            framebufferCreateInfo.width = swapChainExtent.width;
+            framebufferCreateInfo.height = swapChainExtent.height;
+            framebufferCreateInfo.layers = 1;
+
+            if (vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create framebuffer");
+            }
+        }
+    }
+
+    void createCommandPool() {
+        QueueFamilyIndices indices = findQueueFamilyIndices(physicalDevice);
+
+        VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+        commandPoolCreateInfo.sType =VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        // command buffers are re-recorded every frame
+        commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolCreateInfo.queueFamilyIndex = indices.graphicsFamily;
+
+        if (vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool");
+        }
+
+        VkCommandPoolCreateInfo transferCommandPoolCreateInfo = {};
+        transferCommandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        transferCommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        transferCommandPoolCreateInfo.queueFamilyIndex = indices.transferFamily;
+
+        if (vkCreateCommandPool(device, &transferCommandPoolCreateInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transfer command pool");
+        }
+
+        if (options.gpuCulling) {
+            VkCommandPoolCreateInfo computeCommandPoolCreateInfo = {};
+            computeCommandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            computeCommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            computeCommandPoolCreateInfo.queueFamilyIndex = indices.computeFamily;
+
+            if (vkCreateCommandPool(device, &computeCommandPoolCreateInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute command pool");
+            }
+        }
+    }
+
+    static bool isMeshFilePath(const std::string& path) {
+        return path.size() >= 5 && path.compare(path.size() - 5, 5, ".mesh") == 0;
+    }
+
+    void loadMesh() {
+        meshLoadStart = std::chrono::steady_clock::now();
+        if (isMeshFilePath(options.meshPath)) {
+            mapMeshFile();
+            return;
+        }
+
+        std::vector<Vertex> triangleList;
+        if (!options.meshPath.empty()) {
+            triangleList = loadObj(options.meshPath);
+            std::cout << options.meshPath << " parsed in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshLoadStart).count()
+                      << " ms" << std::endl;
+        } else {
+            triangleList = options.gridSize > 0 ? generateGridTriangles(options.gridSize) : triangleVertices;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        deduplicateVertices(triangleList, vertices, indices);
+        double acmrBefore = computeAcmr(indices, vertices.size());
+        optimizeVertexCache(indices, vertices.size());
+        optimizeVertexFetch(vertices, indices);
+        double acmrAfter = computeAcmr(indices, vertices.size());
+        auto end = std::chrono::steady_clock::now();
+
+        // beyond 16 bits the index buffer doubles in size
+        indexType = vertices.size() <= std::numeric_limits<uint16_t>::max() ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        vertexCount = static_cast<uint32_t>(vertices.size());
+        indexCount = static_cast<uint32_t>(indices.size());
+        meshRadius = computeMeshRadius(vertices);
+
+        std::cout << "mesh imported in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms: "
+                  << triangleList.size() << " -> " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, "
+                  << (indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << " bit indices, ACMR " << acmrBefore << " -> " << acmrAfter
+                  << " (" << VERTEX_CACHE_SIZE << " entry FIFO)" << std::endl;
+        if (options.gridSize == 0 && options.meshPath.empty()) {
+            // every corner of the two triangles has a color of its own, there is nothing to share or reorder
+            std::cout << "the built in triangles share no vertices, use --grid or --mesh to see deduplication and cache ordering" << std::endl;
+        }
+    }
+
+    // the file already holds optimized vertices in the gpu layout, only the header is read here and the data is
+    // copied from the mapping into the staging buffer when the buffers are created
+    void mapMeshFile() {
+        meshFile = MappedFile(options.meshPath);
+        meshFileView = viewMeshFile(meshFile, options.meshPath);
+        const MeshFileHeader& header = *meshFileView.header;
+        if (!withVertexType([&](auto vertex) { return hasVertexLayout<decltype(vertex)>(header); })) {
+            throw std::runtime_error(options.meshPath + " doesn't hold " + vertexFormatName(options.vertexFormat)
+                                     + " vertices, convert it with the --vertex-format it is drawn with");
+        }
+
+        indexType = header.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        vertexCount = header.vertexCount;
+        indexCount = header.indexCount;
+        meshRadius = header.radius;
+
+        std::cout << options.meshPath << " mapped: " << vertexCount << " vertices, " << indexCount / 3 << " triangles, "
+                  << header.indexSize * 8 << " bit indices, " << meshFile.getSize() / 1024.0 << " KiB" << std::endl;
+    }
+
+    void printMeshLoadStats() {
+        const double mebibyte = 1024.0 * 1024.0;
+        std::cout << options.meshPath << " loaded and uploaded in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshLoadStart).count()
+                  << " ms, peak process memory " << getPeakProcessMemory() / mebibyte << " MiB" << std::endl;
+    }
+
+    // quads shuffled into random order, the worst case for the vertex cache and a stand-in for a large imported mesh
+    static std::vector<Vertex> generateGridTriangles(uint32_t gridSize) {
+        auto gridVertex = [gridSize](uint32_t x, uint32_t y) {
+            float u = static_cast<float>(x) / gridSize;
+            float v = static_cast<float>(y) / gridSize;
+            return Vertex{{u - 0.5f, v - 0.5f}, {u, v, 1.0f - u}};
+        };
+
+        std::vector<std::array<Vertex, 6>> quads;
+        quads.reserve(gridSize * gridSize);
+        for (uint32_t y = 0; y < gridSize; ++y) {
+            for (uint32_t x = 0; x < gridSize; ++x) {
+                Vertex topLeft = gridVertex(x, y);
+                Vertex topRight = gridVertex(x + 1, y);
+                Vertex bottomLeft = gridVertex(x, y + 1);
+                Vertex bottomRight = gridVertex(x + 1, y + 1);
+                quads.push_back({topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight});
+            }
+        }
+
+        std::mt19937 random(42);
+        std::shuffle(quads.begin(), quads.end(), random);
+
+        std::vector<Vertex> triangleList;
+        triangleList.reserve(quads.size() * 6);
+        for (const auto& quad : quads) {
+            triangleList.insert(triangleList.end(), quad.begin(), quad.end());
+        }
+        return triangleList;
+    }
+
+    // calls function with a default constructed vertex of the type options.vertexFormat stores on the gpu
+    template<typename Function>
+    auto withVertexType(Function&& function) const -> decltype(function(Vertex())) {
+        switch (options.vertexFormat) {
+        case VertexFormat::Packed:
+            return function(PackedVertex());
+        case VertexFormat::Half:
+            return function(HalfVertex());
+        case VertexFormat::Snorm:
+            return function(SnormVertex());
+        case VertexFormat::Float:
+            break;
+        }
+        return function(Vertex());
+    }
+
+    uint32_t getVertexStride() const {
+        return withVertexType([](auto vertex) { return static_cast<uint32_t>(sizeof(vertex)); });
+    }
+
+    void createVertexBuffer() {
+        const VkDeviceSize size = static_cast<VkDeviceSize>(vertexCount) * getVertexStride();
+        // mapped mesh files are copied from the page cache as they are
+        const void* data = meshFileView.vertexData;
+        std::vector<char> converted;
+        if (data == nullptr) {
+            if (options.vertexFormat == VertexFormat::Snorm) {
+                for (const Vertex& vertex : vertices) {
+                    if (std::abs(vertex.position.x) > 1.0f || std::abs(vertex.position.y) > 1.0f) {
+                        throw std::runtime_error("mesh positions outside [-1, 1] can't be stored as snorm");
+                    }
+                }
+            }
+
+            VertexStream stream;
+            copyToVertexStream(vertices.data(), vertices.size(), stream);
+            converted.resize(size);
+            withVertexType([&](auto vertex) {
+                packVertexStream(stream, reinterpret_cast<decltype(vertex)*>(converted.data()));
+            });
+            data = converted.data();
+        }
+
+        createDeviceLocalBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, data, vertexBuffer, vertexBufferAllocation);
+        flushUploads();
+
+        std::cout << "vertex format " << vertexFormatName(options.vertexFormat) << ": " << getVertexStride() << " bytes per vertex, "
+                  << size / 1024.0 << " KiB vertex buffer (" << 100.0 * getVertexStride() / sizeof(Vertex) << "% of float)" << std::endl;
+    }
+
+    void createIndexBuffer() {
+        if (meshFileView.indexData != nullptr) {
+            createDeviceLocalBuffer(meshFileView.indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, meshFileView.indexData, indexBuffer, indexBufferAllocation);
+            flushUploads();
+            // the whole mesh is on the gpu now
+            meshFileView = MeshFileView();
+            meshFile = MappedFile();
+            return;
+        }
+
+        if (indexType == VK_INDEX_TYPE_UINT32) {
+            VkDeviceSize size = indices.size() * sizeof(indices[0]);
+            createDeviceLocalBuffer(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.data(), indexBuffer, indexBufferAllocation);
+            flushUploads();
+            return;
+        }
+
+        std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+        VkDeviceSize size = shortIndices.size() * sizeof(shortIndices[0]);
+        createDeviceLocalBuffer(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, shortIndices.data(), indexBuffer, indexBufferAllocation);
+        // before shortIndices goes out of scope
+        flushUploads();
+    }
+
+    void createStreamingBuffer() {
+        if (options.streamVertexCount > 0) {
+            generateStreamingVertices(options.streamVertexCount - options.streamVertexCount % 3);
+        }
+
+        // one frame being written, the ones in flight being read, and slack for alignment and wrapping
+        VkDeviceSize bytesPerFrame = std::max(DEFAULT_STREAMING_BYTES_PER_FRAME, streamingBaseVertices.size() * getVertexStride() + STREAMING_ALIGNMENT);
+        bytesPerFrame += getUniformBytesPerFrame(ObjectDataPath::DescriptorSets) + uniformAlignment;
+        bytesPerFrame += options.textureCount * sizeof(uint32_t) + uniformAlignment;
+        VkDeviceSize size = bytesPerFrame * (options.framesInFlight + 2);
+        createBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, streamingBuffer);
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetBufferMemoryRequirements(device, streamingBuffer, &memoryRequirements);
+
+        const VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        const VkMemoryPropertyFlags directFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | hostFlags;
+        // on uma it's all the same memory, on discrete gpus the gpu reads it over the bus, which is cheaper
+        // than a copy for data that is used once
+        if (isUnifiedMemoryArchitecture() && allocator.hasMemoryType(memoryRequirements.memoryTypeBits, directFlags)) {
+            streamingBufferAllocation = allocator.allocateBuffer(streamingBuffer, directFlags);
+        } else {
+            streamingBufferAllocation = allocator.allocateBuffer(streamingBuffer, hostFlags);
+        }
+        streamingRing.init(streamingBuffer, size, streamingBufferAllocation.mapped);
+    }
+
+    // small triangles, one per grid cell
+    void generateStreamingVertices(uint32_t count) {
+        const uint32_t triangles = count / 3;
+        const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(triangles))));
+        const float cellSize = 2.0f / std::max(columns, 1u);
+
+        streamingAmplitude = cellSize * 0.1f;
+        streamingBaseVertices.resize(count);
+        for (uint32_t i = 0; i < triangles; ++i) {
+            glm::vec2 center = {-1.0f + (i % columns + 0.5f) * cellSize, -1.0f + (i / columns + 0.5f) * cellSize};
+            float size = cellSize * 0.4f;
+            streamingBaseVertices[i * 3 + 0] = {center + glm::vec2(0.0f, -size), {1.0f, 0.0f, 0.0f}};
+            streamingBaseVertices[i * 3 + 1] = {center + glm::vec2(-size, size), {0.0f, 1.0f, 0.0f}};
+            streamingBaseVertices[i * 3 + 2] = {center + glm::vec2(size, size), {0.0f, 0.0f, 1.0f}};
+        }
+        // the colors never change, only the positions are animated
+        copyToVertexStream(streamingBaseVertices.data(), streamingBaseVertices.size(), streamingVertices);
+    }
+
+    // animates every streamed vertex on the cpu and packs it straight into this frame's ring buffer region
+    void updateStreamingVertices() {
+        auto start = std::chrono::steady_clock::now();
+
+        const VkDeviceSize size = streamingBaseVertices.size() * getVertexStride();
+        RingBuffer::Region region = streamingRing.allocate(size, STREAMING_ALIGNMENT);
+
+        float time = std::chrono::duration<float>(start - animationStart).count();
+        for (size_t i = 0; i < streamingBaseVertices.size(); ++i) {
+            const Vertex& base = streamingBaseVertices[i];
+            float phase = time * 4.0f + static_cast<float>(i / 3) * 0.05f;
+            streamingVertices.x[i] = base.position.x + std::sin(phase) * streamingAmplitude;
+            streamingVertices.y[i] = base.position.y + std::cos(phase) * streamingAmplitude;
+        }
+        // written sequentially and never read back, the memory may be write combined
+        withVertexType([&](auto vertex) {
+            packVertexStream(streamingVertices, static_cast<decltype(vertex)*>(region.data));
+        });
+        streamingVertexOffset = region.offset;
+
+        auto end = std::chrono::steady_clock::now();
+        streamedBytes += size;
+        streamingWriteSeconds += std::chrono::duration<double>(end - start).count();
+        ++streamedFrames;
+
+        double seconds = std::chrono::duration<double>(end - streamingReportStart).count();
+        if (seconds >= 1.0) {
+            std::cout << "streamed " << streamedBytes / seconds / (1024.0 * 1024.0) << " MiB/s ("
+                      << streamedBytes / streamedFrames / (1024.0 * 1024.0) << " MiB per frame, cpu write "
+                      << streamingWriteSeconds * 1000.0 / streamedFrames << " ms per frame, "
+                      << streamedBytes / streamingWriteSeconds / (1024.0 * 1024.0 * 1024.0) << " GiB/s while writing)" << std::endl;
+            streamedBytes = 0;
+            streamingWriteSeconds = 0.0;
+            streamedFrames = 0;
+            streamingReportStart = end;
+        }
+    }
+
+    // the first object leaves the scene as it is, the others are offset, tinted and spinning a little
+    void generateObjectData(uint32_t count) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        // bindless objects are read as a storage buffer from the same regions
+        uniformAlignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+        objectUniformStride = (sizeof(ObjectData) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+
+        // fixed seed keeps benchmark runs comparable
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+        // the objects overlap almost entirely, at a depth each
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        objectData.resize(count);
+        objectData[0] = {{1.0f, 1.0f, 1.0f, 1.0f}, {0.0f, 0.0f}, 0.0f, 0.5f};
+        for (uint32_t i = 1; i < count; ++i) {
+            glm::vec4 color = {0.75f + 0.25f * signedUnit(random), 0.75f + 0.25f * signedUnit(random), 0.75f + 0.25f * signedUnit(random), 1.0f};
+            objectData[i] = {color, {0.05f * signedUnit(random), 0.05f * signedUnit(random)}, signedUnit(random), unit(random)};
+        }
+    }
+
+    // fills drawOrder with the object each draw draws
+    void sortDraws(DrawOrder order) {
+        drawOrder.resize(objectData.size());
+        std::iota(drawOrder.begin(), drawOrder.end(), 0);
+        if (order == DrawOrder::Submission) {
+            return;
+        }
+
+        std::vector<uint64_t> keys(objectData.size());
+        for (size_t i = 0; i < objectData.size(); ++i) {
+            // every object is drawn with the scene pipeline and the same material, only the depth orders them
+            keys[i] = makeDrawSortKey(0, 0, objectData[i].depth, order == DrawOrder::FrontToBack);
+        }
+        radixSortDrawKeys(keys, drawOrder);
+    }
+
+    static const char* drawOrderName(DrawOrder order) {
+        switch (order) {
+        case DrawOrder::Submission:
+            return "submission order";
+        case DrawOrder::FrontToBack:
+            return "front to back";
+        case DrawOrder::BackToFront:
+            return "back to front";
+        }
+        return "unknown";
+    }
+
+    // the scene's permutation with another depth mode, for the two halves of the depth prepass
+    PipelineKey getDepthPassKey(DepthMode depthMode) const {
+        PipelineKey key = sceneKey;
+        key.depthMode = depthMode;
+        return key;
+    }
+
+    // the objects follow the frame uniforms in the frame's region
+    VkDeviceSize getObjectsOffset() const {
+        return (sizeof(FrameUniforms) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+    }
+
+    // only the first object is written with push constants, bindless objects are a tightly packed array
+    size_t getWrittenObjectCount(ObjectDataPath path) const {
+        return path == ObjectDataPath::PushConstants ? 1 : objectData.size();
+    }
+
+    VkDeviceSize getObjectStride(ObjectDataPath path) const {
+        return path == ObjectDataPath::Bindless ? sizeof(ObjectData) : objectUniformStride;
+    }
+
+    VkDeviceSize getUniformBytesPerFrame(ObjectDataPath path) const {
+        return getObjectsOffset() + getWrittenObjectCount(path) * getObjectStride(path);
+    }
+
+    // the frame and object sets point into the streaming buffer, so the same two sets serve every frame
+    void createDescriptorSets() {
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSize.descriptorCount = 2;
+
+        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+        descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCreateInfo.maxSets = 2;
+        descriptorPoolCreateInfo.poolSizeCount = 1;
+        descriptorPoolCreateInfo.pPoolSizes = &poolSize;
+
+        if (vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool");
+        }
+
+        std::array<VkDescriptorSetLayout, 2> setLayouts = {frameDescriptorSetLayout, objectDescriptorSetLayout};
+        std::array<VkDescriptorSet, 2> sets;
+        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+        descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocateInfo.descriptorPool = descriptorPool;
+        descriptorSetAllocateInfo.descriptorSetCount = setLayouts.size();
+        descriptorSetAllocateInfo.pSetLayouts = setLayouts.data();
+
+        if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, sets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets");
+        }
+        frameDescriptorSet = sets[0];
+        objectDescriptorSet = sets[1];
+
+        std::array<VkDescriptorBufferInfo, 2> bufferInfos = {};
+        bufferInfos[0].buffer = streamingBuffer;
+        bufferInfos[0].range = sizeof(FrameUniforms);
+        bufferInfos[1].buffer = streamingBuffer;
+        bufferInfos[1].range = sizeof(ObjectData);
+
+        std::array<VkWriteDescriptorSet, 2> writes = {};
+        for (uint32_t i = 0; i < writes.size(); ++i) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = sets[i];
+            writes[i].dstBinding = 0;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+
+        if (bindlessSupported) {
+            for (auto& frame : frames) {
+                // pointed at the frame's objects every frame
+                frame.objectBufferSlot = bindlessTable.addBuffer(streamingBuffer, 0, sizeof(ObjectData));
+                if (options.textureCount > 0) {
+                    frame.textureBufferSlot = bindlessTable.addBuffer(streamingBuffer, 0, sizeof(uint32_t));
+                }
+            }
+        }
+
+        if (options.objectDataPath != ObjectDataPath::DescriptorSets && !options.descriptorBenchmark) {
+            return;
+        }
+        poolSize.descriptorCount = objectData.size();
+        descriptorPoolCreateInfo.maxSets = objectData.size();
+        for (auto& frame : frames) {
+            if (vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &frame.objectDescriptorPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create object descriptor pool");
+            }
+        }
+    }
+
+    void destroyDescriptorSets() {
+        for (auto& frame : frames) {
+            vkDestroyDescriptorPool(device, frame.objectDescriptorPool, nullptr);
+        }
+        if (bindlessSupported) {
+            bindlessTable.destroy();
+            vkDestroySampler(device, bindlessSampler, nullptr);
+        }
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, objectDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, frameDescriptorSetLayout, nullptr);
+    }
+
+    // writes the frame's uniforms into the streaming ring, with per object descriptor sets also allocates and
+    // points a set at every object's slot
+    void updateUniforms(FrameResources& frame) {
+        RingBuffer::Region region = streamingRing.allocate(getUniformBytesPerFrame(objectDataPath), uniformAlignment);
+        const VkDeviceSize objectsOffset = getObjectsOffset();
+        const VkDeviceSize objectStride = getObjectStride(objectDataPath);
+        const size_t writtenObjects = getWrittenObjectCount(objectDataPath);
+
+        FrameUniforms frameUniforms = {};
+        frameUniforms.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - animationStart).count();
+        // the slots themselves are written once the frame's residency changes are recorded
+        frameUniforms.textureBuffer = frame.textureBufferSlot;
+        frameUniforms.textureCount = options.textureCount;
+        memcpy(region.data, &frameUniforms, sizeof(frameUniforms));
+
+        // push constants carry the objects, the slot only has to be valid for the bound set
+        char* objects = static_cast<char*>(region.data) + objectsOffset;
+        if (objectStride == sizeof(ObjectData)) {
+            memcpy(objects, objectData.data(), writtenObjects * sizeof(ObjectData));
+        } else {
+            for (size_t i = 0; i < writtenObjects; ++i) {
+                memcpy(objects + i * objectStride, &objectData[i], sizeof(ObjectData));
+            }
+        }
+        frameUniformOffset = static_cast<uint32_t>(region.offset);
+        objectUniformOffset = static_cast<uint32_t>(region.offset + objectsOffset);
+
+        if (objectDataPath == ObjectDataPath::Bindless) {
+            // the frame's own slot, none of the frames in flight read it
+            bindlessTable.updateBuffer(frame.objectBufferSlot, streamingBuffer, objectUniformOffset, writtenObjects * sizeof(ObjectData));
+            objectBufferSlot = frame.objectBufferSlot;
+        }
+
+        objectDescriptorSets.clear();
+        if (objectDataPath != ObjectDataPath::DescriptorSets) {
+            return;
+        }
+        // the frame's fence has been waited for, none of its sets are still in use
+        vkResetDescriptorPool(device, frame.objectDescriptorPool, 0);
+
+        std::vector<VkDescriptorSetLayout> setLayouts(objectData.size(), objectDescriptorSetLayout);
+        objectDescriptorSets.resize(objectData.size());
+        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+        descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocateInfo.descriptorPool = frame.objectDescriptorPool;
+        descriptorSetAllocateInfo.descriptorSetCount = setLayouts.size();
+        descriptorSetAllocateInfo.pSetLayouts = setLayouts.data();
+
+        if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, objectDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate object descriptor sets");
+        }
+
+        std::vector<VkDescriptorBufferInfo> bufferInfos(objectData.size());
+        std::vector<VkWriteDescriptorSet> writes(objectData.size());
+        for (size_t i = 0; i < objectData.size(); ++i) {
+            bufferInfos[i].buffer = streamingBuffer;
+            bufferInfos[i].offset = objectUniformOffset + i * objectUniformStride;
+            bufferInfos[i].range = sizeof(ObjectData);
+
+            writes[i] = {};
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = objectDescriptorSets[i];
+            writes[i].dstBinding = 0;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+    }
+
+    // binds the frame uniforms and the first object, with the uniform paths also selects them in the shader
+    void bindUniforms(VkCommandBuffer commandBuffer) {
+        if (objectDataPath == ObjectDataPath::Bindless) {
+            std::array<VkDescriptorSet, 2> sets = {frameDescriptorSet, bindlessTable.getSet()};
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, sets.size(), sets.data(), 1, &frameUniformOffset);
+            bindObjectData(commandBuffer, 0);
+            return;
+        }
+
+        std::array<VkDescriptorSet, 2> sets = {frameDescriptorSet, objectDescriptorSet};
+        std::array<uint32_t, 2> dynamicOffsets = {frameUniformOffset, objectUniformOffset};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, sets.size(), sets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+
+        ObjectPushConstants constants = {objectData[0], OBJECT_SOURCE_PUSH_CONSTANTS};
+        if (objectDataPath != ObjectDataPath::PushConstants) {
+            constants.objectSource = OBJECT_SOURCE_UNIFORM_BUFFER;
+        }
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+    }
+
+    void bindObjectData(VkCommandBuffer commandBuffer, uint32_t objectIndex) {
+        // the frame's object region and the descriptor sets have a slot per object
+        assert(objectIndex < objectData.size());
+        assert(objectDataPath != ObjectDataPath::DescriptorSets || objectIndex < objectDescriptorSets.size());
+        switch (objectDataPath) {
+        case ObjectDataPath::PushConstants: {
+            ObjectPushConstants constants = {objectData[objectIndex], OBJECT_SOURCE_PUSH_CONSTANTS};
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+            break;
+        }
+        case ObjectDataPath::DynamicUniform: {
+            uint32_t dynamicOffset = objectUniformOffset + objectIndex * objectUniformStride;
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &objectDescriptorSet, 1, &dynamicOffset);
+            break;
+        }
+        case ObjectDataPath::DescriptorSets: {
+            // the set already points at the object's slot
+            uint32_t dynamicOffset = 0;
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &objectDescriptorSets[objectIndex], 1, &dynamicOffset);
+            break;
+        }
+        case ObjectDataPath::Bindless: {
+            BindlessPushConstants constants = {objectBufferSlot, objectIndex};
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+            break;
+        }
+        }
+    }
+
+    // a checkerboard in a color of its own per texture, stands in for decoding image files
+    static MipChain generateTexture(uint32_t index, uint32_t size) {
+        std::mt19937 random(index);
+        std::uniform_int_distribution<uint32_t> channel(64, 255);
+        const uint32_t red = channel(random);
+        const uint32_t green = channel(random);
+        const uint32_t blue = channel(random);
+        const uint32_t color = 0xff000000u | blue << 16 | green << 8 | red;
+        // 8 to 64 cells across, so the levels differ
+        const uint32_t cellSize = std::max(size / (8u << (index % 4)), 1u);
+
+        std::vector<uint32_t> pixels(static_cast<size_t>(size) * size);
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                pixels[static_cast<size_t>(y) * size + x] = (x / cellSize + y / cellSize) % 2 ? color : 0xffffffffu;
+            }
+        }
+        return MipChain::fromBaseLevel(size, std::move(pixels));
+    }
+
+    // starts loading every texture on the worker pool, they are drawn with the default texture until their
+    // smallest levels are resident
+    void createTextures() {
+        textureLoadStart = std::chrono::steady_clock::now();
+        const VkDeviceSize baseLevelBytes = static_cast<VkDeviceSize>(options.textureSize) * options.textureSize * sizeof(uint32_t);
+        textureStreamer.init(device, allocator, *workerPool, bindlessTable, std::max(TEXTURE_UPLOAD_BYTES_PER_FRAME, baseLevelBytes), options.framesInFlight);
+        for (uint32_t i = 0; i < options.textureCount; ++i) {
+            const uint32_t size = options.textureSize;
+            textureStreamer.add([i, size]() {
+                return generateTexture(i, size);
+            });
+        }
+        updateTextureDemand();
+    }
+
+    // the mesh spans a unit at scale 1 and the texture spans the mesh, a unit covers half the extent
+    void updateTextureDemand() {
+        const float pixelsPerUnit = std::max(swapChainExtent.width, swapChainExtent.height) * 0.5f;
+        for (uint32_t i = 0; i < options.textureCount; ++i) {
+            textureStreamer.setDemand(i, textureScales[i] * pixelsPerUnit);
+        }
+    }
+
+    // the configured budget, lowered to what VK_EXT_memory_budget reports the device local heap has left
+    void updateTextureBudget() {
+        VkDeviceSize budget = static_cast<VkDeviceSize>(options.textureBudgetMiB) * 1024 * 1024;
+        if (memoryBudgetSupported) {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudget = {};
+            memoryBudget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+            VkPhysicalDeviceMemoryProperties2 properties = {};
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            properties.pNext = &memoryBudget;
+            vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+
+            const VkPhysicalDeviceMemoryProperties& memoryProperties = properties.memoryProperties;
+            for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+                if (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+                    const uint32_t heap = memoryProperties.memoryTypes[i].heapIndex;
+                    // the usage includes the textures themselves
+                    VkDeviceSize otherUsage = memoryBudget.heapUsage[heap] - std::min(memoryBudget.heapUsage[heap], textureStreamer.getCommittedBytes());
+                    budget = std::min(budget, memoryBudget.heapBudget[heap] - std::min(memoryBudget.heapBudget[heap], otherUsage));
+                    break;
+                }
+            }
+        }
+        textureStreamer.setBudget(budget);
+    }
+
+    // records the frame's residency changes ahead of the render pass and points the frame's slot buffer at
+    // the images the instances sample
+    void updateTextures(FrameResources& frame, VkCommandBuffer commandBuffer) {
+        auto timer = profiler.scope("textures");
+        updateTextureBudget();
+        textureStreamer.update(commandBuffer, submittedFrameCount + 1);
+
+        const VkDeviceSize size = options.textureCount * sizeof(uint32_t);
+        RingBuffer::Region region = streamingRing.allocate(size, uniformAlignment);
+        uint32_t* slots = static_cast<uint32_t*>(region.data);
+        for (uint32_t i = 0; i < options.textureCount; ++i) {
+            slots[i] = textureStreamer.getSlot(i);
+        }
+        // the frame's own slot, none of the frames in flight read it
+        bindlessTable.updateBuffer(frame.textureBufferSlot, streamingBuffer, region.offset, size);
+
+        const TextureStreamer::Stats& stats = textureStreamer.getStats();
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - textureLoadStart).count();
+        if (!texturesResidentReported && stats.residentCount == stats.textureCount) {
+            std::cout << "textures: first frame with all " << stats.textureCount << " textures resident recorded " << milliseconds
+                      << " ms after loading started" << std::endl;
+            texturesResidentReported = true;
+        }
+        if (!texturesCompleteReported && textureStreamer.isComplete()) {
+            std::cout << "textures: every texture resident at its demanded level " << milliseconds << " ms after loading started" << std::endl;
+            printTextureStats();
+            texturesCompleteReported = true;
+        }
+    }
+
+    void printTextureStats() {
+        const TextureStreamer::Stats& stats = textureStreamer.getStats();
+        const double mebibyte = 1024.0 * 1024.0;
+        std::cout << "textures: " << stats.residentCount << " of " << stats.textureCount << " resident, " << stats.completeCount
+                  << " at their demanded level, " << stats.residentBytes / mebibyte << " MiB resident of a "
+                  << textureStreamer.getBudget() / mebibyte << " MiB budget" << (memoryBudgetSupported ? " (VK_EXT_memory_budget)" : "")
+                  << ", peak " << stats.peakResidentBytes / mebibyte << " MiB, " << stats.uploadedBytes / mebibyte << " MiB uploaded, "
+                  << stats.evictedLevels << " levels evicted, peak process memory " << getPeakProcessMemory() / mebibyte << " MiB" << std::endl;
+    }
+
+    // the bindless path has its own shader and pipeline layout, switching to or from it rebuilds the pipelines
+    void setObjectDataPath(ObjectDataPath path) {
+        if ((path == ObjectDataPath::Bindless) == (objectDataPath == ObjectDataPath::Bindless)) {
+            objectDataPath = path;
+            return;
+        }
+
+        vkDeviceWaitIdle(device);
+        // also waits for permutations still compiling against the old layout
+        pipelineCompiler.destroy();
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+
+        objectDataPath = path;
+        createGraphicsPipeline();
+        pipelineCompiler.request(sceneKey);
+    }
+
+    static const char* objectDataPathName(ObjectDataPath path) {
+        switch (path) {
+        case ObjectDataPath::PushConstants:
+            return "push constants";
+        case ObjectDataPath::DynamicUniform:
+            return "dynamic uniform offsets";
+        case ObjectDataPath::DescriptorSets:
+            return "per object descriptor sets";
+        case ObjectDataPath::Bindless:
+            return "bindless";
+        }
+        return "unknown";
+    }
+
+    void runDescriptorBenchmark() {
+        const bool profilerEnabled = profiler.isEnabled();
+        profiler.setEnabled(true);
+
+        std::cout << "rendering " << objectData.size() << " objects with a draw each, " << DESCRIPTOR_BENCHMARK_FRAMES
+                  << " frames per path" << (options.headless ? "" : ", windowed results are capped by the present mode") << std::endl;
+        std::cout << "path\tuniforms ms\trecord ms\tms/frame" << std::endl;
+
+        auto renderFrame = [this]() {
+            if (options.headless) {
+                renderOffscreen();
+            } else {
+                pollInput();
+                render();
+            }
+        };
+
+        std::vector<ObjectDataPath> paths = {ObjectDataPath::PushConstants, ObjectDataPath::DynamicUniform, ObjectDataPath::DescriptorSets};
+        if (bindlessSupported) {
+            paths.push_back(ObjectDataPath::Bindless);
+        }
+        for (ObjectDataPath path : paths) {
+            setObjectDataPath(path);
+            for (uint32_t frame = 0; frame < BENCHMARK_WARMUP_FRAMES; ++frame) {
+                renderFrame();
+            }
+            vkDeviceWaitIdle(device);
+            profiler.clear();
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < DESCRIPTOR_BENCHMARK_FRAMES; ++frame) {
+                renderFrame();
+            }
+            vkDeviceWaitIdle(device);
+            auto end = std::chrono::steady_clock::now();
+
+            std::cout << objectDataPathName(path) << "\t" << profiler.summarize("uniforms").avg << "\t" << profiler.summarize("record").avg
+                      << "\t" << std::chrono::duration<double, std::milli>(end - start).count() / DESCRIPTOR_BENCHMARK_FRAMES << std::endl;
+        }
+
+        setObjectDataPath(options.objectDataPath);
+        profiler.clear();
+        profiler.setEnabled(profilerEnabled);
+    }
+
+    void runDepthBenchmark() {
+        struct Configuration {
+            const char* name;
+            DepthMode depthMode;
+            DrawOrder drawOrder;
+            bool prepass;
+        };
+        const std::array<Configuration, 6> configurations = {{
+            {"no depth test", DepthMode::Off, DrawOrder::Submission, false},
+            {"back to front", DepthMode::TestAndWrite, DrawOrder::BackToFront, false},
+            {"submission order", DepthMode::TestAndWrite, DrawOrder::Submission, false},
+            {"front to back", DepthMode::TestAndWrite, DrawOrder::FrontToBack, false},
+            {"prepass, submission order", DepthMode::TestAndWrite, DrawOrder::Submission, true},
+            {"prepass, front to back", DepthMode::TestAndWrite, DrawOrder::FrontToBack, true}
+        }};
+
+        const bool profilerEnabled = profiler.isEnabled();
+        profiler.setEnabled(true);
+        const PipelineKey originalSceneKey = sceneKey;
+
+        std::cout << "rendering " << objectData.size() << " overlapping objects with a draw each, " << DEPTH_BENCHMARK_FRAMES
+                  << " frames per configuration" << (options.headless ? "" : ", windowed results are capped by the present mode") << std::endl;
+        if (statisticsQueryPool == VK_NULL_HANDLE) {
+            std::cout << "device doesn't support pipeline statistics queries" << (options.recordingThreads > 0 ? " inherited by secondary command buffers" : "")
+                      << ", fragment shader invocations not reported" << std::endl;
+        }
+        std::cout << "configuration\tsort ms\tms/frame\tgpu ms\tfragment invocations" << std::endl;
+
+        auto renderFrame = [this]() {
+            if (options.headless) {
+                renderOffscreen();
+            } else {
+                pollInput();
+                render();
+            }
+        };
+
+        for (const Configuration& configuration : configurations) {
+            auto sortStart = std::chrono::steady_clock::now();
+            sortDraws(configuration.drawOrder);
+            auto sortEnd = std::chrono::steady_clock::now();
+
+            sceneKey.depthMode = configuration.depthMode;
+            depthPrepass = configuration.prepass;
+            // measured with the configuration's permutations instead of the fallback
+            pipelineCompiler.wait(sceneKey);
+            if (depthPrepass) {
+                pipelineCompiler.wait(getDepthPassKey(DepthMode::Prepass));
+                pipelineCompiler.wait(getDepthPassKey(DepthMode::Equal));
+            }
+
+            for (uint32_t frame = 0; frame < BENCHMARK_WARMUP_FRAMES; ++frame) {
+                renderFrame();
+            }
+            vkDeviceWaitIdle(device);
+            profiler.clear();
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < DEPTH_BENCHMARK_FRAMES; ++frame) {
+                renderFrame();
+            }
+            vkDeviceWaitIdle(device);
+            auto end = std::chrono::steady_clock::now();
+
+            std::cout << configuration.name << "\t" << std::chrono::duration<double, std::milli>(sortEnd - sortStart).count()
+                      << "\t" << std::chrono::duration<double, std::milli>(end - start).count() / DEPTH_BENCHMARK_FRAMES
+                      << "\t" << profiler.summarize("gpu render pass").avg << "\t";
+            if (statisticsQueryPool != VK_NULL_HANDLE) {
+                std::cout << static_cast<uint64_t>(readFragmentInvocations());
+            } else {
+                std::cout << "-";
+            }
+            std::cout << std::endl;
+        }
+
+        sceneKey = originalSceneKey;
+        depthPrepass = options.depthPrepass;
+        sortDraws(options.drawOrder);
+        profiler.clear();
+        profiler.setEnabled(profilerEnabled);
+    }
+
+    void createInstanceBuffer(uint32_t count) {
+        std::vector<Instance> instances;
+        if (options.gpuCulling) {
+            std::vector<BoundingCircle> bounds;
+            instances = generateCullingScene(count, meshRadius, bounds);
+            objectBounds.resize(bounds.size());
+            for (size_t i = 0; i < bounds.size(); ++i) {
+                objectBounds[i] = {{bounds[i].x, bounds[i].y}, bounds[i].radius, 0.0f};
+            }
+        } else if (options.cpuCulling) {
+            std::vector<BoundingCircle> bounds;
+            std::vector<Instance> unsorted = generateCullingScene(count, meshRadius, bounds);
+
+            auto start = std::chrono::steady_clock::now();
+            sceneBvh.build(bounds);
+            auto end = std::chrono::steady_clock::now();
+            std::cout << "bvh over " << count << " objects built in " << std::chrono::duration<double, std::milli>(end - start).count()
+                      << " ms, " << sceneBvh.getNodeCount() << " nodes" << std::endl;
+
+            // stored in bvh order, so visible subtrees are contiguous ranges of instances
+            instances.reserve(unsorted.size());
+            for (uint32_t index : sceneBvh.getOrder()) {
+                instances.push_back(unsorted[index]);
+            }
+        } else {
+            instances = generateInstances(count);
+        }
+        if (options.textureCount > 0) {
+            // instance i samples texture i % textureCount
+            textureScales.assign(options.textureCount, 0.0f);
+            for (size_t i = 0; i < instances.size(); ++i) {
+                float& scale = textureScales[i % options.textureCount];
+                scale = std::max(scale, instances[i].scale);
+            }
+        }
+        VkDeviceSize size = instances.size() * sizeof(instances[0]);
+        createDeviceLocalBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, instances.data(), instanceBuffer, instanceBufferAllocation);
+        flushUploads();
+        instanceCount = count;
+    }
+
+    static float computeMeshRadius(const std::vector<Vertex>& meshVertices) {
+        float radius = 0.0f;
+        for (const Vertex& vertex : meshVertices) {
+            radius = std::max(radius, glm::length(vertex.position));
+        }
+        return radius;
+    }
+
+    // instances spread over CULLING_WORLD_SCALE view widths, and the bounding circle of each
+    std::vector<Instance> generateCullingScene(uint32_t count, float meshRadius, std::vector<BoundingCircle>& bounds) const {
+        std::vector<Instance> instances = generateInstances(count);
+        bounds.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); ++i) {
+            instances[i].offset *= CULLING_WORLD_SCALE;
+            bounds[i] = {instances[i].offset.x, instances[i].offset.y, meshRadius * instances[i].scale};
+        }
+        return instances;
+    }
+
+    // the view planes for the bvh
+    static std::vector<Plane2D> getCullingPlanes() {
+        std::vector<Plane2D> planes;
+        for (const glm::vec4& plane : getViewPlanes()) {
+            planes.push_back({plane.x, plane.y, plane.z});
+        }
+        return planes;
+    }
+
+    void cullObjects() {
+        // small scenes aren't worth the hand off to the workers
+        ThreadPool* threadPool = instanceCount >= PARALLEL_CULLING_MIN_OBJECTS ? workerPool.get() : nullptr;
+        sceneBvh.cull(getCullingPlanes(), visibleRanges, threadPool);
+
+        visibleObjectCount = 0;
+        for (const Bvh::Range& range : visibleRanges) {
+            visibleObjectCount += range.count;
+        }
+    }
+
+    void runCullBenchmark() {
+        const uint32_t count = options.instanceCount > 1 ? options.instanceCount : DEFAULT_CULL_BENCHMARK_OBJECTS;
+        std::vector<BoundingCircle> bounds;
+        generateCullingScene(count, computeMeshRadius(triangleVertices), bounds);
+        const std::vector<Plane2D> planes = getCullingPlanes();
+
+        Bvh bvh;
+        auto buildStart = std::chrono::steady_clock::now();
+        bvh.build(bounds);
+        auto buildEnd = std::chrono::steady_clock::now();
+        std::cout << count << " objects, bvh built in " << std::chrono::duration<double, std::milli>(buildEnd - buildStart).count()
+                  << " ms, " << bvh.getNodeCount() << " nodes, average of " << CULL_BENCHMARK_ITERATIONS << " culls" << std::endl;
+
+        auto averageMilliseconds = [this](const std::function<void()>& cull) {
+            // warm up
+            cull();
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < CULL_BENCHMARK_ITERATIONS; ++i) {
+                cull();
+            }
+            auto end = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::milli>(end - start).count() / CULL_BENCHMARK_ITERATIONS;
+        };
+
+        // every object against every plane, what culling costs without the hierarchy. tests the objects'
+        // bounding boxes like the bvh's leaves, so both find the same visible objects
+        std::vector<uint32_t> visibleObjects;
+        double bruteForceMilliseconds = averageMilliseconds([&]() {
+            visibleObjects.clear();
+            for (uint32_t i = 0; i < count; ++i) {
+                bool visible = true;
+                for (const Plane2D& plane : planes) {
+                    // distance of the box corner furthest along the normal
+                    const float extent = (std::abs(plane.nx) + std::abs(plane.ny)) * bounds[i].radius;
+                    visible = visible && plane.nx * bounds[i].x + plane.ny * bounds[i].y + plane.distance >= -extent;
+                }
+                if (visible) {
+                    visibleObjects.push_back(i);
+                }
+            }
+        });
+        std::cout << "brute force: " << bruteForceMilliseconds << " ms, " << visibleObjects.size() << " visible" << std::endl;
+
+        // doubling up to every hardware thread
+        std::vector<size_t> threadCounts;
+        for (size_t threads = 1; threads < ThreadPool::defaultThreadCount(); threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(ThreadPool::defaultThreadCount());
+
+        std::vector<Bvh::Range> ranges;
+        for (size_t threads : threadCounts) {
+            // a pool per thread count, the culling splits its work by the pool size
+            std::unique_ptr<ThreadPool> pool = threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr;
+            double milliseconds = averageMilliseconds([&]() { bvh.cull(planes, ranges, pool.get()); });
+
+            uint64_t visible = 0;
+            for (const Bvh::Range& range : ranges) {
+                visible += range.count;
+            }
+            std::cout << "bvh, " << threads << " threads: " << milliseconds << " ms (" << bruteForceMilliseconds / milliseconds << "x), "
+                      << visible << " visible in " << ranges.size() << " draws" << std::endl;
+        }
+    }
+
+    // object bounds and a draw buffer per frame, written by the culling pass and read by the indirect draws
+    void createCullingResources() {
+        createDeviceLocalBuffer(objectBounds.size() * sizeof(ObjectBounds), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, objectBounds.data(), objectBoundsBuffer, objectBoundsAllocation);
+        flushUploads();
+
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = 2 * frames.size();
+
+        VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+        descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCreateInfo.maxSets = frames.size();
+        descriptorPoolCreateInfo.poolSizeCount = 1;
+        descriptorPoolCreateInfo.pPoolSizes = &poolSize;
+
+        if (vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &cullingDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling descriptor pool");
+        }
+
+        const VkDeviceSize drawBufferSize = DRAW_COMMANDS_OFFSET + objectBounds.size() * sizeof(VkDrawIndexedIndirectCommand);
+        for (auto& frame : frames) {
+            createBuffer(drawBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, frame.drawBuffer);
+            frame.drawBufferAllocation = allocator.allocateBuffer(frame.drawBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+            createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, frame.drawCountReadbackBuffer);
+            frame.drawCountReadbackAllocation = allocator.allocateBuffer(frame.drawCountReadbackBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            memset(frame.drawCountReadbackAllocation.mapped, 0, sizeof(uint32_t));
+
+            VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+            descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            descriptorSetAllocateInfo.descriptorPool = cullingDescriptorPool;
+            descriptorSetAllocateInfo.descriptorSetCount = 1;
+            descriptorSetAllocateInfo.pSetLayouts = &cullingDescriptorSetLayout;
+
+            if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &frame.cullingDescriptorSet) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate culling descriptor set");
+            }
+
+            std::array<VkDescriptorBufferInfo, 2> bufferInfos = {};
+            bufferInfos[0].buffer = objectBoundsBuffer;
+            bufferInfos[0].range = VK_WHOLE_SIZE;
+            bufferInfos[1].buffer = frame.drawBuffer;
+            bufferInfos[1].range = VK_WHOLE_SIZE;
+
+            std::array<VkWriteDescriptorSet, 2> writes = {};
+            for (uint32_t i = 0; i < writes.size(); ++i) {
+                writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[i].dstSet = frame.cullingDescriptorSet;
+                writes[i].dstBinding = i;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[i].pBufferInfo = &bufferInfos[i];
+            }
+            vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+
+            VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+            commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            commandBufferAllocateInfo.commandPool = computeCommandPool;
+            commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            commandBufferAllocateInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &frame.cullingCommandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate culling command buffer");
+            }
+            createSemaphore(&frame.cullingFinishedSemaphore);
+        }
+
+        QueueFamilyIndices indices = findQueueFamilyIndices(physicalDevice);
+        std::cout << "gpu culling " << objectBounds.size() << " objects on the "
+                  << (indices.computeFamily == indices.graphicsFamily ? "graphics" : "async compute")
+                  << " queue, " << (vkCmdDrawIndexedIndirectCount != nullptr ? "compacted draws with an indirect count" : "one indirect draw slot per object")
+                  << std::endl;
+    }
+
+    void destroyCullingResources() {
+        for (auto& frame : frames) {
+            vkDestroySemaphore(device, frame.cullingFinishedSemaphore, nullptr);
+            vkDestroyBuffer(device, frame.drawBuffer, nullptr);
+            allocator.free(frame.drawBufferAllocation);
+            vkDestroyBuffer(device, frame.drawCountReadbackBuffer, nullptr);
+            allocator.free(frame.drawCountReadbackAllocation);
+        }
+        vkDestroyDescriptorPool(device, cullingDescriptorPool, nullptr);
+        vkDestroyBuffer(device, objectBoundsBuffer, nullptr);
+        allocator.free(objectBoundsAllocation);
+
+        vkDestroyPipeline(device, cullingPipeline, nullptr);
+        vkDestroyPipelineLayout(device, cullingPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, cullingDescriptorSetLayout, nullptr);
+        vkDestroyCommandPool(device, computeCommandPool, nullptr);
+    }
+
+    // clip space bounds, the vertex shader has no camera
+    static std::array<glm::vec4, 4> getViewPlanes() {
+        return {{
+            {1.0f, 0.0f, 1.0f, 0.0f},
+            {-1.0f, 0.0f, 1.0f, 0.0f},
+            {0.0f, 1.0f, 1.0f, 0.0f},
+            {0.0f, -1.0f, 1.0f, 0.0f}
+        }};
+    }
+
+    void recordCullingCommandBuffer(FrameResources& frame) {
+        VkCommandBuffer commandBuffer = frame.cullingCommandBuffer;
+
+        VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+
+        vkCmdFillBuffer(commandBuffer, frame.drawBuffer, 0, sizeof(uint32_t), 0);
+
+        VkBufferMemoryBarrier countClearedBarrier = {};
+        countClearedBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        countClearedBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        countClearedBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        countClearedBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        countClearedBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        countClearedBarrier.buffer = frame.drawBuffer;
+        countClearedBarrier.offset = 0;
+        countClearedBarrier.size = sizeof(uint32_t);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &countClearedBarrier, 0, nullptr);
+
+        CullingConstants constants = {};
+        std::array<glm::vec4, 4> planes = getViewPlanes();
+        std::copy(planes.begin(), planes.end(), constants.planes);
+        constants.objectCount = objectBounds.size();
+        constants.indexCount = indexCount;
+        constants.compact = vkCmdDrawIndexedIndirectCount != nullptr ? 1 : 0;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipelineLayout, 0, 1, &frame.cullingDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, cullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, (constants.objectCount + CULLING_WORKGROUP_SIZE - 1) / CULLING_WORKGROUP_SIZE, 1, 1);
+
+        // the draws wait on the semaphore, only the statistics copy needs a barrier
+        VkBufferMemoryBarrier culledBarrier = countClearedBarrier;
+        culledBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        culledBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &culledBarrier, 0, nullptr);
+
+        VkBufferCopy countCopy = {};
+        countCopy.size = sizeof(uint32_t);
+        vkCmdCopyBuffer(commandBuffer, frame.drawBuffer, frame.drawCountReadbackBuffer, 1, &countCopy);
+
+        VkBufferMemoryBarrier readbackBarrier = {};
+        readbackBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        readbackBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        readbackBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        readbackBarrier.buffer = frame.drawCountReadbackBuffer;
+        readbackBarrier.offset = 0;
+        readbackBarrier.size = sizeof(uint32_t);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &readbackBarrier, 0, nullptr);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record culling command buffer");
+        }
+    }
+
+    // a single call whatever the object count, unless the device lacks multiDrawIndirect
+    void recordIndirectDraws(VkCommandBuffer commandBuffer, const FrameResources& frame, VkPipeline drawPipeline) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+
+        VkViewport viewport = {};
+        viewport.width = swapChainExtent.width;
+        viewport.height = swapChainExtent.height;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor = {};
+        scissor.extent = swapChainExtent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        VkBuffer vertexBuffers[] = {vertexBuffer, instanceBuffer};
+        VkDeviceSize offsets[] = {0, 0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+        // the culled objects are instances, every indirect draw uses the first object
+        bindUniforms(commandBuffer);
+
+        const uint32_t objectCount = objectBounds.size();
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        if (vkCmdDrawIndexedIndirectCount != nullptr) {
+            vkCmdDrawIndexedIndirectCount(commandBuffer, frame.drawBuffer, DRAW_COMMANDS_OFFSET, frame.drawBuffer, 0, objectCount, stride);
+        } else if (multiDrawIndirectSupported) {
+            vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, DRAW_COMMANDS_OFFSET, objectCount, stride);
+        } else {
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, DRAW_COMMANDS_OFFSET + i * stride, 1, stride);
+            }
+        }
+    }
+
+    void destroyInstanceBuffer() {
+        vkDestroyBuffer(device, instanceBuffer, nullptr);
+        allocator.free(instanceBufferAllocation);
+    }
+
+    // a single instance reproduces the untransformed mesh, more are scattered over a grid covering the viewport
+    static std::vector<Instance> generateInstances(uint32_t count) {
+        if (count == 1) {
+            return {{{0.0f, 0.0f}, 1.0f, 0.0f, {1.0f, 1.0f, 1.0f}}};
+        }
+
+        const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        const float cellSize = 2.0f / columns;
+
+        // fixed seed keeps benchmark runs comparable
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        std::vector<Instance> instances(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            Instance& instance = instances[i];
+            instance.offset = {-1.0f + (i % columns + 0.5f) * cellSize, -1.0f + (i / columns + 0.5f) * cellSize};
+            instance.scale = cellSize;
+            instance.rotation = unit(random) * 2.0f * static_cast<float>(M_PI);
+            instance.color = {unit(random), unit(random), unit(random)};
+        }
+        return instances;
+    }
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer) {
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.usage = usage;
+        bufferCreateInfo.size = size;
+
+        QueueFamilyIndices indices = findQueueFamilyIndices(physicalDevice);
+        std::set<uint32_t> uniqueQueueFamilyIndices = {
+            static_cast<uint32_t>(indices.graphicsFamily),
+            static_cast<uint32_t>(indices.transferFamily)
+        };
+        if (options.gpuCulling) {
+            uniqueQueueFamilyIndices.insert(indices.computeFamily);
+        }
+        std::vector<uint32_t> queueFamilyIndices(uniqueQueueFamilyIndices.begin(), uniqueQueueFamilyIndices.end());
+
+        // written on the transfer or compute queue and read on the graphics queue, concurrent sharing
+        // avoids queue family ownership transfers
+        if (queueFamilyIndices.size() == 1) {
+            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        } else {
+            bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferCreateInfo.queueFamilyIndexCount = queueFamilyIndices.size();
+            bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+        }
+
+        if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer");
+        }
+    }
+
+    // data has to stay valid until the next flushUploads()
+    void createDeviceLocalBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const void* data, VkBuffer& buffer, Allocation& allocation) {
+        createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer);
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+        const VkMemoryPropertyFlags directFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (isUnifiedMemoryArchitecture() && allocator.hasMemoryType(memoryRequirements.memoryTypeBits, directFlags)) {
+            // uma, device local memory is the same memory the cpu writes to, no copy needed
+            allocation = allocator.allocateBuffer(buffer, directFlags);
+            memcpy(allocation.mapped, data, size);
+        } else {
+            allocation = allocator.allocateBuffer(buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            pendingUploads.push_back({buffer, 0, size, data});
+        }
+    }
+
+    bool isUnifiedMemoryArchitecture() {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        // discrete gpus may also expose a small device local, host visible heap (the pci bar),
+        // which is too scarce to place static geometry in
+        return properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU
+            || properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+    }
+
+    // copies all pending uploads through one staging buffer in a single submission and waits for it
+    void flushUploads() {
+        if (pendingUploads.empty()) {
+            return;
+        }
+
+        VkDeviceSize stagingSize = 0;
+        for (const auto& upload : pendingUploads) {
+            stagingSize += upload.size;
+        }
+
+        VkBuffer stagingBuffer;
+        createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stagingBuffer);
+        Allocation stagingAllocation = allocator.allocateBuffer(stagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.commandPool = transferCommandPool;
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocateInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate transfer command buffer");
+        }
+
+        VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+
+        char *mapped = static_cast<char*>(stagingAllocation.mapped);
+
+        VkDeviceSize stagingOffset = 0;
+        for (const auto& upload : pendingUploads) {
+            memcpy(mapped + stagingOffset, upload.data, upload.size);
+
+            VkBufferCopy region = {};
+            region.srcOffset = stagingOffset;
+            region.dstOffset = upload.dstOffset;
+            region.size = upload.size;
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, upload.dstBuffer, 1, &region);
+
+            stagingOffset += upload.size;
+        }
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record transfer command buffer");
+        }
+
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence uploadFence;
+        if (vkCreateFence(device, &fenceCreateInfo, nullptr, &uploadFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create fence");
+        }
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        if (vkQueueSubmit(transferQueue, 1, &submitInfo, uploadFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit transfer command buffer");
+        }
+        vkWaitForFences(device, 1, &uploadFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+        vkDestroyFence(device, uploadFence, nullptr);
+        vkFreeCommandBuffers(device, transferCommandPool, 1, &commandBuffer);
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        allocator.free(stagingAllocation);
+
+        pendingUploads.clear();
+    }
+
+    void createFrameResources() {
+        frames.resize(options.framesInFlight);
+
+        std::vector<VkCommandBuffer> commandBuffers(frames.size());
+
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.commandPool = commandPool;
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocateInfo.commandBufferCount = commandBuffers.size();
+
+        if (vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, commandBuffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers");
+        }
+
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        // signaled so the first wait for each frame returns immediately
+        fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (size_t i = 0; i < frames.size(); ++i) {
+            frames[i].commandBuffer = commandBuffers[i];
+            createSemaphore(&frames[i].imageAcquiredSemaphore);
+            createSemaphore(&frames[i].renderingFinishedSemaphore);
+
+            if (vkCreateFence(device, &fenceCreateInfo, nullptr, &frames[i].inFlightFence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create fence");
+            }
+
+            createRecordingJobs(frames[i].recordingJobs, options.recordingThreads);
+        }
+    }
+
+    void createTimestampQueryPool() {
+        QueueFamilyIndices indices = findQueueFamilyIndices(physicalDevice);
+
+        uint32_t queueFamilyCount;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        uint32_t timestampValidBits = queueFamilies[indices.graphicsFamily].timestampValidBits;
+        if (timestampValidBits == 0) {
+            std::cout << "graphics queue doesn't support timestamps, gpu timings disabled" << std::endl;
+            return;
+        }
+        timestampMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        timestampPeriod = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+        queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolCreateInfo.queryCount = 2 * frames.size();
+
+        if (vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &timestampQueryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool");
+        }
+
+        for (size_t i = 0; i < frames.size(); ++i) {
+            frames[i].firstTimestampQuery = 2 * i;
+        }
+    }
+
+    void createStatisticsQueryPool() {
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+        queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        queryPoolCreateInfo.queryCount = frames.size();
+        queryPoolCreateInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+        if (vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &statisticsQueryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline statistics query pool");
+        }
+
+        for (size_t i = 0; i < frames.size(); ++i) {
+            frames[i].statisticsQuery = i;
+        }
+    }
+
+    // average over the last frame rendered with each frame's resources, the device has to be idle
+    double readFragmentInvocations() {
+        std::vector<uint64_t> invocations(frames.size());
+        if (vkGetQueryPoolResults(device, statisticsQueryPool, 0, invocations.size(), invocations.size() * sizeof(invocations[0]), invocations.data(), sizeof(invocations[0]), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return 0.0;
+        }
+        return std::accumulate(invocations.begin(), invocations.end(), 0.0) / invocations.size();
+    }
+
+    // called once the frame's fence is signaled, so the results are available without waiting
+    void readTimestamps(FrameResources& frame) {
+        uint64_t timestamps[2];
+        if (vkGetQueryPoolResults(device, timestampQueryPool, frame.firstTimestampQuery, 2, sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return;
+        }
+        uint64_t begin = timestamps[0] & timestampMask;
+        uint64_t end = timestamps[1] & timestampMask;
+
+        // the gpu clock has no defined relation to the cpu clock, its first reading is pinned to the submit
+        // of that frame, later ones are placed relative to it, close enough to line up frames in a trace
+        if (!gpuClockCalibrated) {
+            gpuCalibrationTicks = begin;
+            gpuCalibrationTime = frame.submitTime;
+            gpuClockCalibrated = true;
+        }
+        auto toCpuTime = [this](uint64_t ticks) {
+            double nanoseconds = static_cast<double>(static_cast<int64_t>(ticks - gpuCalibrationTicks)) * timestampPeriod;
+            return gpuCalibrationTime + std::chrono::duration_cast<Profiler::Clock::duration>(std::chrono::duration<double, std::nano>(nanoseconds));
+        };
+
+        profiler.record("gpu render pass", Profiler::Track::Gpu, toCpuTime(begin), toCpuTime(end));
+    }
+
+    void createRecordingJobs(std::vector<RecordingJob>& jobs, size_t count) {
+        QueueFamilyIndices indices = findQueueFamilyIndices(physicalDevice);
+        jobs.resize(count);
+
+        for (auto& job : jobs) {
+            VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+            commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            // reset as a whole every frame
+            commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            commandPoolCreateInfo.queueFamilyIndex = indices.graphicsFamily;
+
+            if (vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &job.commandPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create command pool");
+            }
+
+            VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+            commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            commandBufferAllocateInfo.commandPool = job.commandPool;
+            commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            commandBufferAllocateInfo.commandBufferCount = 2;
+
+            std::array<VkCommandBuffer, 2> commandBuffers;
+            if (vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, commandBuffers.data()) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate secondary command buffers");
+            }
+            job.commandBuffer = commandBuffers[0];
+            job.prepassCommandBuffer = commandBuffers[1];
+        }
+    }
+
+    void destroyRecordingJobs(std::vector<RecordingJob>& jobs) {
+        for (const auto& job : jobs) {
+            vkDestroyCommandPool(device, job.commandPool, nullptr);
+        }
+        jobs.clear();
+    }
+
+    void recordCommandBuffer(FrameResources& frame, uint32_t imageIndex) {
+        VkCommandBuffer commandBuffer = frame.commandBuffer;
+        // switches over once the scene's permutation finished compiling
+        activePipeline = pipelineCompiler.get(sceneKey, pipeline);
+        prepassPipeline = VK_NULL_HANDLE;
+        if (depthPrepass) {
+            // both halves or neither, the equal test shades nothing where the prepass didn't write depth
+            VkPipeline depthOnly = pipelineCompiler.get(getDepthPassKey(DepthMode::Prepass), VK_NULL_HANDLE);
+            VkPipeline shading = pipelineCompiler.get(getDepthPassKey(DepthMode::Equal), VK_NULL_HANDLE);
+            if (depthOnly != VK_NULL_HANDLE && shading != VK_NULL_HANDLE) {
+                prepassPipeline = depthOnly;
+                activePipeline = shading;
+            }
+        }
+
+        VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+
+        // uploads are outside the timed render pass
+        if (options.textureCount > 0) {
+            updateTextures(frame, commandBuffer);
+        }
+
+        // nothing reads them back while the profiler is off
+        frame.timestampsRecorded = timestampQueryPool != VK_NULL_HANDLE && profiler.isEnabled();
+        if (frame.timestampsRecorded) {
+            vkCmdResetQueryPool(commandBuffer, timestampQueryPool, frame.firstTimestampQuery, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, frame.firstTimestampQuery);
+        }
+        if (statisticsQueryPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffer, statisticsQueryPool, frame.statisticsQuery, 1);
+            vkCmdBeginQuery(commandBuffer, statisticsQueryPool, frame.statisticsQuery, 0);
+        }
+
+        VkRenderPassBeginInfo renderPassBeginInfo = {};
+        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBeginInfo.renderPass = renderPass;
+        renderPassBeginInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        renderPassBeginInfo.renderArea.offset = {0, 0};
+        renderPassBeginInfo.renderArea.extent = swapChainExtent;
+        std::array<VkClearValue, 2> clearValues = {};
+        clearValues[0].color = {{0.0f, 0.2f, 0.6f, 1.0f}};
+        clearValues[1].depthStencil = {1.0f, 0};
+        renderPassBeginInfo.clearValueCount = clearValues.size();
+        renderPassBeginInfo.pClearValues = clearValues.data();
+
+        // with cpu culling every visible range of instances is a draw
+        const uint32_t drawCount = options.cpuCulling ? visibleRanges.size() : options.drawCount;
+        if (options.gpuCulling) {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            if (prepassPipeline != VK_NULL_HANDLE) {
+                recordIndirectDraws(commandBuffer, frame, prepassPipeline);
+            }
+            recordIndirectDraws(commandBuffer, frame, activePipeline);
+        } else if (frame.recordingJobs.empty()) {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            recordDraws(commandBuffer, 0, drawCount);
+        } else {
+            vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            recordSecondaryCommandBuffers(frame.recordingJobs, swapChainFramebuffers[imageIndex], drawCount);
+
+            // the whole depth prepass comes first, so every job shades against the depth of all draws
+            std::vector<VkCommandBuffer> secondaryCommandBuffers;
+            if (prepassPipeline != VK_NULL_HANDLE) {
+                for (const auto& job : frame.recordingJobs) {
+                    secondaryCommandBuffers.push_back(job.prepassCommandBuffer);
+                }
+            }
+            for (const auto& job : frame.recordingJobs) {
+                secondaryCommandBuffers.push_back(job.commandBuffer);
+            }
+            vkCmdExecuteCommands(commandBuffer, secondaryCommandBuffers.size(), secondaryCommandBuffers.data());
+        }
+
+        vkCmdEndRenderPass(commandBuffer);
+
+        if (statisticsQueryPool != VK_NULL_HANDLE) {
+            vkCmdEndQuery(commandBuffer, statisticsQueryPool, frame.statisticsQuery);
+        }
+        if (frame.timestampsRecorded) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, frame.firstTimestampQuery + 1);
+        }
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer");
+        }
+    }
+
+    // splits the draws evenly across the jobs and records them on the worker pool, returns once all are recorded
+    void recordSecondaryCommandBuffers(std::vector<RecordingJob>& jobs, VkFramebuffer framebuffer, uint32_t drawCount) {
+        const uint32_t drawsPerJob = (drawCount + jobs.size() - 1) / jobs.size();
+
+        std::vector<std::future<void>> recorded;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            uint32_t firstDraw = std::min<uint32_t>(i * drawsPerJob, drawCount);
+            uint32_t jobDrawCount = std::min(drawsPerJob, drawCount - firstDraw);
+            RecordingJob& job = jobs[i];
+            recorded.push_back(workerPool->submit([this, &job, framebuffer, firstDraw, jobDrawCount]() {
+                recordSecondaryCommandBuffer(job, framebuffer, firstDraw, jobDrawCount);
+            }));
+        }
+
+        for (auto& job : recorded) {
+            // rethrows recording errors on the main thread
+            job.get();
+        }
+    }
+
+    // with the depth prepass its draws go into the job's prepass command buffer
+    void recordSecondaryCommandBuffer(RecordingJob& job, VkFramebuffer framebuffer, uint32_t firstDraw, uint32_t drawCount) {
+        // cheaper than resetting the command buffers individually
+        vkResetCommandPool(device, job.commandPool, 0);
+
+        if (prepassPipeline != VK_NULL_HANDLE) {
+            beginSecondaryCommandBuffer(job.prepassCommandBuffer, framebuffer);
+            recordDrawPass(job.prepassCommandBuffer, prepassPipeline, firstDraw, drawCount);
+            if (vkEndCommandBuffer(job.prepassCommandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record secondary command buffer");
+            }
+        }
+
+        beginSecondaryCommandBuffer(job.commandBuffer, framebuffer);
+        recordDrawPass(job.commandBuffer, activePipeline, firstDraw, drawCount);
+        if (vkEndCommandBuffer(job.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record secondary command buffer");
+        }
+    }
+
+    void beginSecondaryCommandBuffer(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer) {
+        VkCommandBufferInheritanceInfo inheritanceInfo = {};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = framebuffer;
+        // executed while the frame's statistics query is active
+        if (statisticsQueryPool != VK_NULL_HANDLE) {
+            inheritanceInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+        }
 
-        if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create pipeline layout");
+        VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+        vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+    }
+
+    // with the depth prepass the draws are recorded twice, the depth of all of them is laid down first
+    void recordDraws(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount) {
+        if (prepassPipeline != VK_NULL_HANDLE) {
+            recordDrawPass(commandBuffer, prepassPipeline, firstDraw, drawCount);
         }
+        recordDrawPass(commandBuffer, activePipeline, firstDraw, drawCount);
+    }
 
-        VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-        pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineCreateInfo.stageCount = sizeof(shaderStages)/sizeof(shaderStages[0]);
-        pipelineCreateInfo.pStages = shaderStages;
-        pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
-        pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
-        pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-        pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
-        pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
-        pipelineCreateInfo.pDepthStencilState = nullptr;
-        pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-        pipelineCreateInfo.pDynamicState = nullptr;
-        pipelineCreateInfo.layout = pipelineLayout;
-        pipelineCreateInfo.renderPass = renderPass;
-        pipelineCreateInfo.subpass = 0;
+    // secondary command buffers don't inherit any state, every one binds its own
+    void recordDrawPass(VkCommandBuffer commandBuffer, VkPipeline drawPipeline, uint32_t firstDraw, uint32_t drawCount) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics pipeline");
+        VkViewport viewport = {};
+        viewport.x = 0;
+        viewport.y = 0;
+        viewport.width = swapChainExtent.width;
+        viewport.height = swapChainExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor = {};
+        scissor.extent = swapChainExtent;
+        scissor.offset = {0, 0};
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        bindUniforms(commandBuffer);
+
+        // draw i draws object drawOrder[i], there is an object for every draw recorded
+        if (!streamingBaseVertices.empty()) {
+            VkBuffer vertexBuffers[] = {streamingBuffer, instanceBuffer};
+            VkDeviceSize offsets[] = {streamingVertexOffset, 0};
+            vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+            for (uint32_t i = firstDraw; i < firstDraw + drawCount; ++i) {
+                bindObjectData(commandBuffer, drawOrder[i]);
+                vkCmdDraw(commandBuffer, streamingBaseVertices.size(), instanceCount, 0, 0);
+            }
+            return;
+        }
+
+        VkBuffer vertexBuffers[] = {vertexBuffer, instanceBuffer};
+        VkDeviceSize offsets[] = {0, 0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+        if (options.cpuCulling) {
+            // the ranges are instances of the first object, bound above
+            for (uint32_t i = firstDraw; i < firstDraw + drawCount; ++i) {
+                vkCmdDrawIndexed(commandBuffer, indexCount, visibleRanges[i].count, 0, 0, visibleRanges[i].first);
+            }
+            return;
+        }
+        for (uint32_t i = firstDraw; i < firstDraw + drawCount; ++i) {
+            bindObjectData(commandBuffer, drawOrder[i]);
+            vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
         }
     }
 
-    static std::vector<char> readFile(const std::string& fileName) {
-        std::ifstream fileStream(fileName, std::ios::ate | std::ios::binary);
-        if (!fileStream.is_open()) {
-            throw std::runtime_error("failed to open file " + fileName);
+    void runRecordingBenchmark() {
+        // draws one object each, parseOptions sized the scene for the benchmark
+        const uint32_t drawCount = options.drawCount;
+        const size_t maxThreads = std::max<size_t>(workerPool->size(), options.recordingThreads);
+
+        std::vector<RecordingJob> jobs;
+        createRecordingJobs(jobs, maxThreads);
+
+        // nothing is submitted, but the draws read the object slots and sets a frame would have written
+        updateUniforms(beginFrame());
+
+        std::cout << "recording " << drawCount << " draws, average of " << RECORDING_BENCHMARK_ITERATIONS << " runs" << std::endl;
+        std::cout << "threads\tms\tspeedup" << std::endl;
+
+        double singleThreadMilliseconds = 0.0;
+        for (size_t threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1) {
+            std::vector<RecordingJob> threadJobs(jobs.begin(), jobs.begin() + threads);
+
+            // warm up, the first recording into a fresh pool includes its allocations
+            recordSecondaryCommandBuffers(threadJobs, swapChainFramebuffers[0], drawCount);
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < RECORDING_BENCHMARK_ITERATIONS; ++i) {
+                recordSecondaryCommandBuffers(threadJobs, swapChainFramebuffers[0], drawCount);
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            double milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / RECORDING_BENCHMARK_ITERATIONS;
+            if (threads == 1) {
+                singleThreadMilliseconds = milliseconds;
+            }
+            std::cout << threads << "\t" << milliseconds << "\t" << singleThreadMilliseconds / milliseconds << std::endl;
         }
-        std::vector<char> fileContent(fileStream.tellg());
-        fileStream.seekg(0);
-        fileStream.read(fileContent.data(), fileContent.size());
-        fileStream.close();
-        return fileContent;
+
+        destroyRecordingJobs(jobs);
     }
 
-    VkShaderModule createShaderModule(const std::vector<char>& byteCode) {
-        VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
-        shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        shaderModuleCreateInfo.codeSize = byteCode.size();
-        shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(byteCode.data());
+    void createSemaphore(VkSemaphore * const semaphore) {
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+        semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkShaderModule shaderModule;
-        if (vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create shader module");
+        if (vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create semaphore");
         }
-        return shaderModule;
     }
 
-    void createFramebuffers() {
-        swapChainFramebuffers.resize(swapChainImageViews.size());
+    void runInstanceBenchmark() {
+        const uint32_t maxInstances = options.instanceCount > 1 ? options.instanceCount : DEFAULT_INSTANCE_BENCHMARK_MAX_INSTANCES;
+        const uint64_t meshTriangles = indexCount / 3;
+
+        std::cout << "rendering " << INSTANCE_BENCHMARK_FRAMES << " frames per instance count"
+                  << (options.headless ? "" : ", windowed results are capped by the present mode") << std::endl;
+        std::cout << "instances\ttriangles\tms/frame\ttriangles/s" << std::endl;
+
+        for (uint32_t count = 1;; count = static_cast<uint32_t>(std::min<uint64_t>(uint64_t(count) * 10, maxInstances))) {
+            // swapping the buffer under in flight frames isn't worth the bookkeeping here
+            vkDeviceWaitIdle(device);
+            destroyInstanceBuffer();
+            createInstanceBuffer(count);
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < INSTANCE_BENCHMARK_FRAMES; ++frame) {
+                if (options.headless) {
+                    renderOffscreen();
+                } else {
+                    pollInput();
+                    render();
+                }
+            }
+            vkDeviceWaitIdle(device);
+            auto end = std::chrono::steady_clock::now();
 
-        for (size_t i = 0; i < swapChainImageViews.size(); ++i) {
-            VkFramebufferCreateInfo framebufferCreateInfo = {};
-            framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebufferCreateInfo.attachmentCount = 1;
-            framebufferCreateInfo.pAttachments = &swapChainImageViews[i];
-            framebufferCreateInfo.renderPass = renderPass;
-            framebufferCreateInfo.width = swapChainExtent.width;
-            framebufferCreateInfo.height = swapChainExtent.height;
-            framebufferCreateInfo.layers = 1;
+            double seconds = std::chrono::duration<double>(end - start).count();
+            uint64_t triangles = meshTriangles * count * options.drawCount;
+            std::cout << count << "\t" << triangles << "\t" << seconds * 1000.0 / INSTANCE_BENCHMARK_FRAMES << "\t"
+                      << triangles * INSTANCE_BENCHMARK_FRAMES / seconds << std::endl;
 
-            if (vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create framebuffer");
+            if (count == maxInstances) {
+                break;
             }
         }
     }
 
-    void createCommandPool() {
-        QueueFamilyIndices indices = findQueueFamilyIndices(physicalDevice);
+    void runBenchmark() {
+        const uint32_t frameLimit = options.frameCount > 0 ? options.frameCount
+            : options.benchmarkSeconds > 0.0 ? std::numeric_limits<uint32_t>::max() : DEFAULT_HEADLESS_FRAME_COUNT;
 
-        VkCommandPoolCreateInfo commandPoolCreateInfo = {};
-        commandPoolCreateInfo.sType =VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        commandPoolCreateInfo.queueFamilyIndex = indices.graphicsFamily;
+        auto renderFrame = [this]() {
+            if (options.headless) {
+                renderOffscreen();
+            } else {
+                pollInput();
+                render();
+            }
+        };
 
-        if (vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create command pool");
+        for (uint32_t frame = 0; frame < BENCHMARK_WARMUP_FRAMES; ++frame) {
+            renderFrame();
         }
-    }
+        vkDeviceWaitIdle(device);
 
-    void createVertexBuffer() {
-        VkBufferCreateInfo bufferCreateInfo = {};
-        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        bufferCreateInfo.size = vertices.size() * sizeof(vertices[0]);
+        std::vector<double> frameTimes;
+        auto start = std::chrono::steady_clock::now();
+        auto previous = start;
+        while (frameTimes.size() < frameLimit) {
+            if (!options.headless && glfwWindowShouldClose(window)) {
+                break;
+            }
+            renderFrame();
+
+            // cpu frame to frame time, with frames in flight it converges to the gpu time once the gpu is the bottleneck
+            auto now = std::chrono::steady_clock::now();
+            frameTimes.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+            previous = now;
+
+            if (options.benchmarkSeconds > 0.0 && std::chrono::duration<double>(now - start).count() >= options.benchmarkSeconds) {
+                break;
+            }
+        }
+        vkDeviceWaitIdle(device);
+        auto end = std::chrono::steady_clock::now();
+
+        const uint64_t trianglesPerFrame = uint64_t(indexCount / 3) * instanceCount * options.drawCount;
+        BenchmarkReport report = BenchmarkReport::fromFrameTimes(frameTimes, std::chrono::duration<double>(end - start).count(), trianglesPerFrame);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        report.configuration = {
+            {"device", properties.deviceName},
+            {"driver_version", std::to_string(properties.driverVersion)},
+            {"present_mode", options.headless ? "offscreen" : presentModeName(presentMode)},
+            {"width", std::to_string(swapChainExtent.width)},
+            {"height", std::to_string(swapChainExtent.height)},
+            {"frames_in_flight", std::to_string(options.framesInFlight)},
+            {"instances", std::to_string(instanceCount)},
+            {"draw_calls", std::to_string(options.drawCount)},
+            {"triangles_per_frame", std::to_string(trianglesPerFrame)},
+            {"vertex_format", vertexFormatName(options.vertexFormat)},
+            {"vertex_bytes", std::to_string(uint64_t(vertexCount) * getVertexStride())},
+            {"culling", options.gpuCulling ? "gpu" : options.cpuCulling ? "cpu" : "off"},
+            {"object_data", objectDataPathName(objectDataPath)},
+        };
 
-        if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &vertexBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create vertex buffer");
+        std::cout << report.frames << " frames in " << report.seconds * 1000.0 << " ms, " << report.framesPerSecond << " fps, "
+                  << report.trianglesPerSecond << " triangles/s" << std::endl;
+        std::cout << "frame time ms: mean " << report.mean << ", median " << report.median << ", p95 " << report.p95
+                  << ", p99 " << report.p99 << ", max " << report.max << std::endl;
+
+        if (!options.benchmarkOutputPath.empty()) {
+            std::ofstream output(options.benchmarkOutputPath, std::ios::trunc);
+            const std::string& path = options.benchmarkOutputPath;
+            if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0) {
+                report.writeCsv(output);
+            } else {
+                report.writeJson(output);
+            }
+            if (!output) {
+                throw std::runtime_error("failed to write benchmark report " + path);
+            }
+            std::cout << "benchmark report written to " << path << std::endl;
         }
+    }
 
-        VkMemoryRequirements memoryRequirements;
-        vkGetBufferMemoryRequirements(device, vertexBuffer, &memoryRequirements);
+    void mainLoop() {
+        if (options.headless) {
+            headlessLoop();
+            return;
+        }
 
-        VkMemoryAllocateInfo memoryAllocateInfo = {};
-        memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memoryAllocateInfo.allocationSize = memoryRequirements.size;
-        memoryAllocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        uint32_t renderedFrames = 0;
+        uint32_t reportFrames = 0;
+        double reportLatency = 0.0;
+        auto reportStart = std::chrono::steady_clock::now();
+        while (!glfwWindowShouldClose(window)) {
+            auto inputTime = pollInput();
+            render();
+            // only up to the return of vkQueuePresentKHR, the present may still wait behind queued ones.
+            // pacing with present wait measures up to the display in "input to display".
+            auto presentTime = std::chrono::steady_clock::now();
+            profiler.record("input to present call", Profiler::Track::Cpu, inputTime, presentTime);
+            if (options.frameCount > 0 && ++renderedFrames >= options.frameCount) {
+                break;
+            }
 
-        if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &vertexBufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate vertex buffer memory");
+            ++reportFrames;
+            reportLatency += std::chrono::duration<double, std::milli>(presentTime - inputTime).count();
+            double seconds = std::chrono::duration<double>(presentTime - reportStart).count();
+            if (seconds >= 1.0) {
+                std::cout << "frame time " << seconds * 1000.0 / reportFrames << " ms, input to present call "
+                          << reportLatency / reportFrames << " ms";
+                if (displayLatencyCount > 0) {
+                    std::cout << ", input to display " << displayLatencySum / displayLatencyCount << " ms";
+                }
+                std::cout << " (" << presentPolicyName(options.presentPolicy) << ", " << presentModeName(presentMode) << ", "
+                          << options.framesInFlight << " frames in flight" << (isPacingOnPresents() ? ", paced on presents" : "") << ")" << std::endl;
+                displayLatencySum = 0.0;
+                displayLatencyCount = 0;
+                if (options.gpuCulling || options.cpuCulling) {
+                    printCullingStats();
+                }
+                if (options.textureCount > 0) {
+                    printTextureStats();
+                }
+                if (profiler.isEnabled()) {
+                    profiler.printSummary(std::cout);
+                }
+                reportFrames = 0;
+                reportLatency = 0.0;
+                reportStart = presentTime;
+            }
         }
 
-        vkBindBufferMemory(device, vertexBuffer, vertexBufferMemory, 0);
+        vkDeviceWaitIdle(device);
+    }
 
-        void *data;
-        vkMapMemory(device, vertexBufferMemory, 0, bufferCreateInfo.size, 0, &data);
-        memcpy(data, vertices.data(), bufferCreateInfo.size);
-        vkUnmapMemory(device, vertexBufferMemory);
+    void printCullingStats() {
+        if (options.gpuCulling) {
+            std::cout << "gpu culling: " << visibleObjectCount << " of " << objectBounds.size() << " objects visible" << std::endl;
+        } else {
+            std::cout << "cpu culling: " << visibleObjectCount << " of " << instanceCount << " objects visible in "
+                      << visibleRanges.size() << " draws" << std::endl;
+        }
     }
 
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags) {
-        VkPhysicalDeviceMemoryProperties memoryProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    void headlessLoop() {
+        const uint32_t frameCount = options.frameCount > 0 ? options.frameCount : DEFAULT_HEADLESS_FRAME_COUNT;
 
-        for (uint32_t i = 0u; i < memoryProperties.memoryTypeCount; ++i) {
-            if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) {
-                return i;
+        auto start = std::chrono::steady_clock::now();
+        auto reportStart = start;
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+            renderOffscreen();
+
+            auto now = std::chrono::steady_clock::now();
+            if (profiler.isEnabled() && now - reportStart >= std::chrono::seconds(1)) {
+                profiler.printSummary(std::cout);
+                reportStart = now;
             }
         }
+        vkDeviceWaitIdle(device);
+        auto end = std::chrono::steady_clock::now();
 
-        throw std::runtime_error("failed to find suitable memory type");
+        double seconds = std::chrono::duration<double>(end - start).count();
+        std::cout << "rendered " << frameCount << " frames in " << seconds * 1000.0 << " ms ("
+                  << frameCount / seconds << " fps, " << options.framesInFlight << " frames in flight)" << std::endl;
+        if (options.gpuCulling || options.cpuCulling) {
+            printCullingStats();
+        }
+        if (options.textureCount > 0) {
+            printTextureStats();
+        }
+        if (profiler.isEnabled()) {
+            profiler.printSummary(std::cout);
+        }
     }
 
-    void createCommandBuffers() {
-        commandBuffers.resize(swapChainFramebuffers.size());
-
-        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        commandBufferAllocateInfo.commandPool = commandPool;
-        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        commandBufferAllocateInfo.commandBufferCount = commandBuffers.size();
+    // waits as long as pacing requires and samples input as late as possible before the frame is recorded,
+    // returns the time input was sampled
+    std::chrono::steady_clock::time_point pollInput() {
+        if (options.fpsLimit > 0) {
+            auto now = std::chrono::steady_clock::now();
+            std::this_thread::sleep_until(nextFrameTime);
+            auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options.fpsLimit));
+            // don't try to catch up after a slow frame
+            nextFrameTime = std::max(now, nextFrameTime) + period;
+        }
 
-        if (vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, commandBuffers.data()) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate command buffers");
+        if (isPacingOnPresents()) {
+            // the gpu finishing a frame doesn't stop fifo from queueing presents, waiting for the display does.
+            // one present may wait behind the one being shown, so the gpu still has a frame to work on.
+            auto timer = profiler.scope("frame pacing");
+            waitForQueuedPresents(1);
+        } else if (framePacing && submittedFrameCount > 0) {
+            // input sampled now is shown with the next frame instead of behind every queued one
+            auto timer = profiler.scope("frame pacing");
+            const FrameResources& previousFrame = frames[(currentFrame + frames.size() - 1) % frames.size()];
+            vkWaitForFences(device, 1, &previousFrame.inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
         }
 
-        for (size_t i = 0; i < commandBuffers.size(); ++i) {
-            VkCommandBufferBeginInfo commandBufferBeginInfo = {};
-            commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-            vkBeginCommandBuffer(commandBuffers[i], &commandBufferBeginInfo);
+        glfwPollEvents();
+        lastInputTime = std::chrono::steady_clock::now();
+        return lastInputTime;
+    }
 
-            VkRenderPassBeginInfo renderPassBeginInfo = {};
-            renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderPassBeginInfo.renderPass = renderPass;
-            renderPassBeginInfo.framebuffer = swapChainFramebuffers[i];
-            renderPassBeginInfo.renderArea.offset = {0, 0};
-            renderPassBeginInfo.renderArea.extent = swapChainExtent;
-            renderPassBeginInfo.clearValueCount = 1;
-            VkClearValue clearValue = {0.0f, 0.2f, 0.6f, 1.0f};
-            renderPassBeginInfo.pClearValues = &clearValue;
-            vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, &vertexBuffer, offsets);
-            vkCmdDraw(commandBuffers[i], vertices.size(), 1, 0, 0);
-            vkCmdEndRenderPass(commandBuffers[i]);
+    bool isPacingOnPresents() const {
+        return framePacing && presentWaitSupported;
+    }
 
-            if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to record command buffer");
+    // waits until at most maxQueued presents haven't reached the display, and measures input to display
+    // latency of the ones that did. a present already shown before the wait returns at once, so the
+    // measurement is an upper bound when the frame took longer than the display interval.
+    void waitForQueuedPresents(size_t maxQueued) {
+        while (queuedPresents.size() > maxQueued) {
+            QueuedPresent present = queuedPresents.front();
+            queuedPresents.pop_front();
+            // presents of a retired swapchain are no longer waited for
+            if (present.swapchain != swapchain) {
+                continue;
             }
+            // a present the display never shows, e.g. of a minimized window, mustn't stall the loop
+            if (vkWaitForPresent(device, swapchain, present.id, PRESENT_WAIT_TIMEOUT_NS) != VK_SUCCESS) {
+                continue;
+            }
+            auto displayTime = std::chrono::steady_clock::now();
+            profiler.record("input to display", Profiler::Track::Cpu, present.inputTime, displayTime);
+            displayLatencySum += std::chrono::duration<double, std::milli>(displayTime - present.inputTime).count();
+            ++displayLatencyCount;
         }
     }
 
-    void createSemaphores() {
-        createSemaphore(&imageAcquiredSemaphore);
-        createSemaphore(&renderingFinishedSemaphore);
+    FrameResources& beginFrame() {
+        FrameResources& frame = frames[currentFrame];
+        {
+            auto timer = profiler.scope("fence wait");
+            // blocks only if the cpu is framesInFlight frames ahead of the gpu
+            vkWaitForFences(device, 1, &frame.inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+
+        if (frame.timestampsPending && profiler.isEnabled()) {
+            readTimestamps(frame);
+        }
+        frame.timestampsPending = false;
+
+        if (frame.drawCountReadbackAllocation.mapped != nullptr) {
+            memcpy(&visibleObjectCount, frame.drawCountReadbackAllocation.mapped, sizeof(visibleObjectCount));
+        }
+
+        // frames complete in submission order, so every frame up to this one is done
+        completedFrameCount = std::max(completedFrameCount, frame.submittedFrame);
+        processDeferredDestructions();
+        streamingRing.retire(completedFrameCount);
+        if (options.textureCount > 0) {
+            textureStreamer.retire(completedFrameCount);
+        }
+
+        return frame;
     }
 
-    void createSemaphore(VkSemaphore * const semaphore) {
-        VkSemaphoreCreateInfo semaphoreCreateInfo = {};
-        semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    void deferDestruction(std::function<void()> destroy) {
+        deferredDestructions.push_back({submittedFrameCount, std::move(destroy)});
+    }
 
-        if (vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, semaphore) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create semaphore");
+    void processDeferredDestructions() {
+        while (!deferredDestructions.empty() && deferredDestructions.front().retireFrame <= completedFrameCount) {
+            deferredDestructions.front().destroy();
+            deferredDestructions.pop_front();
         }
     }
 
-    void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
-            render();
+    void submitFrame(FrameResources& frame, uint32_t imageIndex, bool waitForImage) {
+        vkResetFences(device, 1, &frame.inFlightFence);
+        if (!streamingBaseVertices.empty()) {
+            auto timer = profiler.scope("stream vertices");
+            updateStreamingVertices();
+        }
+        {
+            auto timer = profiler.scope("uniforms");
+            updateUniforms(frame);
+        }
+        if (options.cpuCulling) {
+            auto timer = profiler.scope("cull");
+            cullObjects();
+        }
+        if (options.gpuCulling) {
+            auto timer = profiler.scope("cull");
+            recordCullingCommandBuffer(frame);
+
+            VkSubmitInfo cullingSubmitInfo = {};
+            cullingSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            cullingSubmitInfo.commandBufferCount = 1;
+            cullingSubmitInfo.pCommandBuffers = &frame.cullingCommandBuffer;
+            cullingSubmitInfo.signalSemaphoreCount = 1;
+            cullingSubmitInfo.pSignalSemaphores = &frame.cullingFinishedSemaphore;
+
+            // the frame's fence covers it too, the draws wait for it
+            if (vkQueueSubmit(computeQueue, 1, &cullingSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit culling command buffer");
+            }
+        }
+        {
+            auto timer = profiler.scope("record");
+            recordCommandBuffer(frame, imageIndex);
         }
 
-        vkDeviceWaitIdle(device);
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        if (waitForImage) {
+            waitSemaphores.push_back(frame.imageAcquiredSemaphore);
+            waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &frame.renderingFinishedSemaphore;
+        }
+        if (options.gpuCulling) {
+            waitSemaphores.push_back(frame.cullingFinishedSemaphore);
+            waitStages.push_back(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+        }
+        submitInfo.waitSemaphoreCount = waitSemaphores.size();
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &frame.commandBuffer;
+
+        frame.submitTime = Profiler::Clock::now();
+        {
+            auto timer = profiler.scope("submit");
+            if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit draw command buffer");
+            }
+        }
+        frame.timestampsPending = frame.timestampsRecorded;
+
+        frame.submittedFrame = ++submittedFrameCount;
+        streamingRing.finishFrame(frame.submittedFrame);
+        currentFrame = (currentFrame + 1) % frames.size();
+    }
+
+    void renderOffscreen() {
+        // each frame renders into its own offscreen image, nothing to acquire or present
+        uint32_t imageIndex = currentFrame;
+        FrameResources& frame = beginFrame();
+        submitFrame(frame, imageIndex, false);
     }
 
     void render() {
+        FrameResources& frame = beginFrame();
+
         uint32_t imageIndex;
-        VkResult acquireResult = vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(), imageAcquiredSemaphore, VK_NULL_HANDLE, &imageIndex);
+        VkResult acquireResult;
+        {
+            auto timer = profiler.scope("acquire");
+            acquireResult = vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(), frame.imageAcquiredSemaphore, VK_NULL_HANDLE, &imageIndex);
+        }
 
         if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapchain();
@@ -866,82 +4197,236 @@ private:
         } else if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR) {
             throw std::runtime_error("failed to acquire swapchain image");
         }
+        // the image's previous present is done, and with it the ones queued on retired swapchains before it
+        if (presentedImages[imageIndex]) {
+            destroyRetiredSwapchains();
+        }
 
-        VkSubmitInfo submitInfo = {};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = &imageAcquiredSemaphore;
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = &renderingFinishedSemaphore;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+        submitFrame(frame, imageIndex, true);
+
+        VkSwapchainPresentFenceInfoEXT presentFenceInfo = {};
+        presentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+        VkFence presentFence = VK_NULL_HANDLE;
+        if (swapchainMaintenance1Supported) {
+            presentFence = getPresentFence();
+            presentFenceInfo.swapchainCount = 1;
+            presentFenceInfo.pFences = &presentFence;
+        }
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer");
+        VkPresentIdKHR presentIdInfo = {};
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.pNext = swapchainMaintenance1Supported ? &presentFenceInfo : nullptr;
+        const bool pacingOnPresents = isPacingOnPresents();
+        if (pacingOnPresents) {
+            // increasing across swapchains, which only requires them to increase per swapchain
+            ++presentId;
+            presentIdInfo.swapchainCount = 1;
+            presentIdInfo.pPresentIds = &presentId;
         }
 
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.pNext = pacingOnPresents ? &presentIdInfo : presentIdInfo.pNext;
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = &swapchain;
         presentInfo.pImageIndices = &imageIndex;
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = &renderingFinishedSemaphore;
-        VkResult presentResult = vkQueuePresentKHR(presentQueue, &presentInfo);
+        presentInfo.pWaitSemaphores = &frame.renderingFinishedSemaphore;
+        VkResult presentResult;
+        {
+            auto timer = profiler.scope("present");
+            presentResult = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
+        // out of date presents are still queued and signal their fence
+        if (presentFence != VK_NULL_HANDLE
+            && (presentResult == VK_SUCCESS || presentResult == VK_SUBOPTIMAL_KHR || presentResult == VK_ERROR_OUT_OF_DATE_KHR)) {
+            pendingPresentFences.push_back({presentFence, swapchain});
+        } else if (presentFence != VK_NULL_HANDLE) {
+            freePresentFences.push_back(presentFence);
+        }
+        if (presentResult == VK_SUCCESS || presentResult == VK_SUBOPTIMAL_KHR) {
+            presentedImages[imageIndex] = true;
+        }
+        if (pacingOnPresents && (presentResult == VK_SUCCESS || presentResult == VK_SUBOPTIMAL_KHR)) {
+            queuedPresents.push_back({presentId, swapchain, lastInputTime});
+        }
 
         if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
             recreateSwapchain();
-        } else if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR) {
-            throw std::runtime_error("failed to acquire swapchain image");
+        } else if (presentResult != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swapchain image");
         }
     }
 
-    void cleanupSwapchain() {
-        for (const auto& framebuffer : swapChainFramebuffers) {
-            vkDestroyFramebuffer(device, framebuffer, nullptr);
+    // an unsignaled fence for the next present, reusing the ones of completed presents
+    VkFence getPresentFence() {
+        for (auto it = pendingPresentFences.begin(); it != pendingPresentFences.end();) {
+            if (vkGetFenceStatus(device, it->fence) == VK_SUCCESS) {
+                vkResetFences(device, 1, &it->fence);
+                freePresentFences.push_back(it->fence);
+                it = pendingPresentFences.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        if (!freePresentFences.empty()) {
+            VkFence fence = freePresentFences.back();
+            freePresentFences.pop_back();
+            return fence;
+        }
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        if (vkCreateFence(device, &fenceCreateInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create present fence");
+        }
+        return fence;
+    }
+
+    // destroys a swapchain whose frames have completed once its presents are done. without present fences
+    // that's only known once an image presented on a newer swapchain is acquired again, until then it's kept.
+    void retireSwapchain(VkSwapchainKHR retiredSwapchain) {
+        if (!swapchainMaintenance1Supported) {
+            retiredSwapchains.push_back(retiredSwapchain);
+            return;
+        }
+        waitForPresents(retiredSwapchain);
+        vkDestroySwapchainKHR(device, retiredSwapchain, nullptr);
+    }
+
+    void destroyRetiredSwapchains() {
+        for (VkSwapchainKHR retiredSwapchain : retiredSwapchains) {
+            vkDestroySwapchainKHR(device, retiredSwapchain, nullptr);
+        }
+        retiredSwapchains.clear();
+    }
+
+    // blocks until the presentation engine is done with every present queued on swapchain
+    void waitForPresents(VkSwapchainKHR presentedSwapchain) {
+        if (!swapchainMaintenance1Supported) {
+            // without present fences only an idle present queue guarantees it, only done at shutdown
+            vkQueueWaitIdle(presentQueue);
+            return;
         }
 
-        vkFreeCommandBuffers(device, commandPool, commandBuffers.size(), commandBuffers.data());
+        std::vector<VkFence> fences;
+        for (auto it = pendingPresentFences.begin(); it != pendingPresentFences.end();) {
+            if (it->swapchain == presentedSwapchain) {
+                fences.push_back(it->fence);
+                it = pendingPresentFences.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (fences.empty()) {
+            return;
+        }
+        vkWaitForFences(device, fences.size(), fences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+        vkResetFences(device, fences.size(), fences.data());
+        freePresentFences.insert(freePresentFences.end(), fences.begin(), fences.end());
+    }
 
+    void cleanupPipeline() {
         vkDestroyPipeline(device, pipeline, nullptr);
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
         vkDestroyRenderPass(device, renderPass, nullptr);
+    }
+
+    void cleanupSwapchain() {
+        for (const auto& framebuffer : swapChainFramebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+
+        vkDestroyImageView(device, depthImageView, nullptr);
+        vkDestroyImage(device, depthImage, nullptr);
+        allocator.free(depthImageAllocation);
 
         for (const auto& imageView : swapChainImageViews) {
             vkDestroyImageView(device, imageView, nullptr);
         }
 
-        vkDestroySwapchainKHR(device, swapchain, nullptr);
+        if (options.headless) {
+            for (size_t i = 0; i < swapChainImages.size(); ++i) {
+                vkDestroyImage(device, swapChainImages[i], nullptr);
+                allocator.free(offscreenImageAllocations[i]);
+            }
+        } else {
+            waitForPresents(swapchain);
+            vkDestroySwapchainKHR(device, swapchain, nullptr);
+        }
     }
 
     void cleanup() {
+        // the device is idle, everything deferred can go
+        completedFrameCount = submittedFrameCount;
+        processDeferredDestructions();
+
         cleanupSwapchain();
+        // every present was waited for with its swapchain, the current one's wait covers the retired ones
+        destroyRetiredSwapchains();
+        for (VkFence fence : freePresentFences) {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        pipelineCompiler.destroy();
+        cleanupPipeline();
+        if (options.textureCount > 0) {
+            textureStreamer.destroy();
+        }
+        destroyDescriptorSets();
+
+        if (options.gpuCulling) {
+            destroyCullingResources();
+        }
 
-        vkDestroySemaphore(device, renderingFinishedSemaphore, nullptr);
-        vkDestroySemaphore(device, imageAcquiredSemaphore, nullptr);
+        for (auto& frame : frames) {
+            destroyRecordingJobs(frame.recordingJobs);
+            vkDestroyFence(device, frame.inFlightFence, nullptr);
+            vkDestroySemaphore(device, frame.renderingFinishedSemaphore, nullptr);
+            vkDestroySemaphore(device, frame.imageAcquiredSemaphore, nullptr);
+        }
 
-        vkFreeMemory(device, vertexBufferMemory, nullptr);
+        destroyInstanceBuffer();
+        vkDestroyBuffer(device, streamingBuffer, nullptr);
+        allocator.free(streamingBufferAllocation);
+        vkDestroyBuffer(device, indexBuffer, nullptr);
+        allocator.free(indexBufferAllocation);
         vkDestroyBuffer(device, vertexBuffer, nullptr);
+        allocator.free(vertexBufferAllocation);
 
+        vkDestroyCommandPool(device, transferCommandPool, nullptr);
         vkDestroyCommandPool(device, commandPool, nullptr);
 
-        vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
-        vkDestroyShaderModule(device, vertexShaderModule, nullptr);
+        shaderLibrary.destroy();
+
+        savePipelineCache();
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
+        vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+        vkDestroyQueryPool(device, statisticsQueryPool, nullptr);
+        profiler.closeTrace();
 
+        workerPool.reset();
+
+        allocator.destroy();
         vkDestroyDevice(device, nullptr);
 
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        if (!options.headless) {
+            vkDestroySurfaceKHR(instance, surface, nullptr);
+        }
 
-        auto vkDestroyDebugReportCallbackEXT = reinterpret_cast<PFN_vkDestroyDebugReportCallbackEXT>(vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT"));
-        vkDestroyDebugReportCallbackEXT( instance, callback, nullptr);
+        if (enableValidationLayers) {
+            auto vkDestroyDebugReportCallbackEXT = reinterpret_cast<PFN_vkDestroyDebugReportCallbackEXT>(vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT"));
+            vkDestroyDebugReportCallbackEXT( instance, callback, nullptr);
+        }
 
         vkDestroyInstance(instance, nullptr);
 
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        if (!options.headless) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
     }
 
     GLFWwindow *window;
@@ -952,37 +4437,415 @@ private:
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
-
-    VkSwapchainKHR swapchain;
+    VkQueue transferQueue;
+    VkQueue computeQueue;
+
+    MemoryAllocator allocator;
+    std::unique_ptr<ThreadPool> workerPool;
+
+    Profiler profiler;
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    // only created for the depth benchmark
+    VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+    bool pipelineStatisticsSupported = false;
+    float timestampPeriod = 1.0f;
+    uint64_t timestampMask = ~0ull;
+    bool gpuClockCalibrated = false;
+    uint64_t gpuCalibrationTicks = 0;
+    Profiler::Clock::time_point gpuCalibrationTime;
+
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
     std::vector<VkFramebuffer> swapChainFramebuffers;
-
-    VkShaderModule vertexShaderModule;
-    VkShaderModule fragmentShaderModule;
+    VkFormat depthFormat;
+    VkImage depthImage;
+    VkImageView depthImageView;
+    Allocation depthImageAllocation;
+
+    ShaderLibrary shaderLibrary;
+    std::shared_future<VkShaderModule> vertexShaderModule;
+    std::shared_future<VkShaderModule> fragmentShaderModule;
+    std::shared_future<VkShaderModule> bindlessVertexShaderModule;
+    std::shared_future<VkShaderModule> texturedFragmentShaderModule;
+    std::shared_future<VkShaderModule> cullingShaderModule;
 
     VkRenderPass renderPass;
+    VkDescriptorSetLayout frameDescriptorSetLayout;
+    VkDescriptorSetLayout objectDescriptorSetLayout;
     VkPipelineLayout pipelineLayout;
     VkPipeline pipeline;
+    PipelineCompiler pipelineCompiler;
+    PipelineKey sceneKey;
+    // pipeline the current frame is recorded with
+    VkPipeline activePipeline;
+    // depth only pipeline recorded ahead of activePipeline, null without a depth prepass
+    VkPipeline prepassPipeline = VK_NULL_HANDLE;
+    // the depth benchmark switches it
+    bool depthPrepass = options.depthPrepass;
+    // object drawn by each draw
+    std::vector<uint32_t> drawOrder;
+    bool fillModeNonSolidSupported = false;
+
+    VkDescriptorSetLayout cullingDescriptorSetLayout;
+    VkPipelineLayout cullingPipelineLayout;
+    VkPipeline cullingPipeline;
+    VkDescriptorPool cullingDescriptorPool;
+    VkCommandPool computeCommandPool;
+    std::vector<ObjectBounds> objectBounds;
+    VkBuffer objectBoundsBuffer;
+    Allocation objectBoundsAllocation;
+    bool multiDrawIndirectSupported = false;
+    // VK_KHR_draw_indirect_count, null if the device doesn't support it
+    PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCount = nullptr;
+    uint32_t visibleObjectCount = 0;
+    Bvh sceneBvh;
+    // instance ranges drawn this frame with cpu culling
+    std::vector<Bvh::Range> visibleRanges;
+
+    VkPipelineCache pipelineCache;
+    bool pipelineCacheWarm = false;
 
     VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
+    Allocation vertexBufferAllocation;
+    // empty when the mesh was mapped from a mesh file
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    float meshRadius = 0.0f;
+    VkIndexType indexType;
+    // held until the mesh is uploaded
+    MappedFile meshFile;
+    MeshFileView meshFileView;
+    std::chrono::steady_clock::time_point meshLoadStart;
+    VkBuffer indexBuffer;
+    Allocation indexBufferAllocation;
+
+    // 16 covers the alignment of every vertex attribute format in use
+    static constexpr VkDeviceSize STREAMING_ALIGNMENT = 16;
+    VkBuffer streamingBuffer;
+    Allocation streamingBufferAllocation;
+    RingBuffer streamingRing;
+    std::vector<Vertex> streamingBaseVertices;
+    VertexStream streamingVertices;
+    VkDeviceSize streamingVertexOffset = 0;
+    float streamingAmplitude = 0.0f;
+    std::chrono::steady_clock::time_point animationStart = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point streamingReportStart = animationStart;
+    VkDeviceSize streamedBytes = 0;
+    double streamingWriteSeconds = 0.0;
+    uint32_t streamedFrames = 0;
+    VkBuffer instanceBuffer;
+    Allocation instanceBufferAllocation;
+    uint32_t instanceCount = 0;
+
+    // objectSource in the vertex shader's push constants
+    static constexpr uint32_t OBJECT_SOURCE_PUSH_CONSTANTS = 0;
+    static constexpr uint32_t OBJECT_SOURCE_UNIFORM_BUFFER = 1;
+    // the benchmark switches between paths
+    ObjectDataPath objectDataPath = options.objectDataPath;
+    // one per draw
+    std::vector<ObjectData> objectData;
+    VkDeviceSize uniformAlignment = 1;
+    VkDeviceSize objectUniformStride = sizeof(ObjectData);
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet frameDescriptorSet;
+    VkDescriptorSet objectDescriptorSet;
+    // this frame's regions of the streaming buffer
+    uint32_t frameUniformOffset = 0;
+    uint32_t objectUniformOffset = 0;
+    // this frame's sets with ObjectDataPath::DescriptorSets, one per object
+    std::vector<VkDescriptorSet> objectDescriptorSets;
+    bool physicalDeviceProperties2Supported = false;
+    // VK_EXT_descriptor_indexing with the features the bindless table needs
+    bool bindlessSupported = false;
+    BindlessTable bindlessTable;
+    VkSampler bindlessSampler;
+    // this frame's objects with ObjectDataPath::Bindless
+    uint32_t objectBufferSlot = 0;
+    TextureStreamer textureStreamer;
+    // largest instance scale per texture
+    std::vector<float> textureScales;
+    std::chrono::steady_clock::time_point textureLoadStart;
+    bool texturesResidentReported = false;
+    bool texturesCompleteReported = false;
+    // VK_EXT_memory_budget, only enabled for the textures
+    bool memoryBudgetSupported = false;
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR vkGetPhysicalDeviceMemoryProperties2 = nullptr;
+    // VK_EXT_swapchain_maintenance1, for fences signaled once presents are done
+    bool surfaceMaintenance1Supported = false;
+    bool swapchainMaintenance1Supported = false;
+    struct PresentFence {
+        VkFence fence;
+        VkSwapchainKHR swapchain;
+    };
+    std::vector<PresentFence> pendingPresentFences;
+    std::vector<VkFence> freePresentFences;
+    // without present fences, swapchains retired with their presents possibly still queued
+    std::vector<VkSwapchainKHR> retiredSwapchains;
+    // images presented on the current swapchain, acquiring one again means its present is done
+    std::vector<bool> presentedImages;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    bool framePacing = false;
+    std::chrono::steady_clock::time_point nextFrameTime;
+    std::chrono::steady_clock::time_point lastInputTime;
+    // VK_KHR_present_id and VK_KHR_present_wait, frame pacing waits for presents to be displayed
+    bool presentWaitSupported = false;
+    PFN_vkWaitForPresentKHR vkWaitForPresent = nullptr;
+    uint64_t presentId = 0;
+    struct QueuedPresent {
+        uint64_t id;
+        VkSwapchainKHR swapchain;
+        std::chrono::steady_clock::time_point inputTime;
+    };
+    std::deque<QueuedPresent> queuedPresents;
+    double displayLatencySum = 0.0;
+    uint32_t displayLatencyCount = 0;
+
+    struct PendingUpload {
+        VkBuffer dstBuffer;
+        VkDeviceSize dstOffset;
+        VkDeviceSize size;
+        const void* data;
+    };
+    std::vector<PendingUpload> pendingUploads;
 
     VkCommandPool commandPool;
-    std::vector<VkCommandBuffer> commandBuffers;
+    VkCommandPool transferCommandPool;
+
+    std::vector<FrameResources> frames;
+    size_t currentFrame = 0;
+    uint64_t submittedFrameCount = 0;
+    uint64_t completedFrameCount = 0;
+
+    std::deque<DeferredDestruction> deferredDestructions;
 
-    VkSemaphore imageAcquiredSemaphore;
-    VkSemaphore renderingFinishedSemaphore;
+    std::vector<Allocation> offscreenImageAllocations;
 };
 
-int main() {
-    HelloTriangleApplication app;
+ApplicationOptions parseOptions(int argc, char* argv[]) {
+    ApplicationOptions options;
+    bool drawCountSet = false;
+    bool objectDataPathSet = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            options.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--draw-calls" && i + 1 < argc) {
+            options.drawCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            drawCountSet = true;
+        } else if (arg == "--recording-threads" && i + 1 < argc) {
+            options.recordingThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--record-benchmark") {
+            options.recordBenchmark = true;
+        } else if (arg == "--instances" && i + 1 < argc) {
+            options.instanceCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            if (options.instanceCount == 0) {
+                throw std::runtime_error("--instances must be at least 1");
+            }
+        } else if (arg == "--instance-benchmark") {
+            options.instanceBenchmark = true;
+        } else if (arg == "--grid" && i + 1 < argc) {
+            options.gridSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--mesh" && i + 1 < argc) {
+            options.meshPath = argv[++i];
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            options.tracePath = argv[++i];
+        } else if (arg == "--benchmark") {
+            options.benchmark = true;
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            options.benchmarkSeconds = std::stod(argv[++i]);
+        } else if (arg == "--benchmark-output" && i + 1 < argc) {
+            options.benchmarkOutputPath = argv[++i];
+        } else if (arg == "--stream-vertices" && i + 1 < argc) {
+            options.streamVertexCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            // rounded down to whole triangles, fewer than 3 would stream nothing
+            if (options.streamVertexCount > 0 && options.streamVertexCount < 3) {
+                throw std::runtime_error("--stream-vertices must be at least 3, a whole triangle");
+            }
+        } else if (arg == "--wireframe") {
+            options.wireframe = true;
+        } else if (arg == "--pipeline-benchmark") {
+            options.pipelineBenchmark = true;
+        } else if (arg == "--vertex-kernel-benchmark") {
+            options.vertexKernelBenchmark = true;
+        } else if (arg == "--gpu-culling") {
+            options.gpuCulling = true;
+        } else if (arg == "--cpu-culling") {
+            options.cpuCulling = true;
+        } else if (arg == "--cull-benchmark") {
+            options.cullBenchmark = true;
+        } else if (arg == "--object-data" && i + 1 < argc) {
+            std::string path = argv[++i];
+            objectDataPathSet = true;
+            if (path == "push") {
+                options.objectDataPath = ObjectDataPath::PushConstants;
+            } else if (path == "dynamic") {
+                options.objectDataPath = ObjectDataPath::DynamicUniform;
+            } else if (path == "sets") {
+                options.objectDataPath = ObjectDataPath::DescriptorSets;
+            } else if (path == "bindless") {
+                options.objectDataPath = ObjectDataPath::Bindless;
+            } else {
+                throw std::runtime_error("unknown object data path " + path + ", expected push, dynamic, sets or bindless");
+            }
+        } else if (arg == "--descriptor-benchmark") {
+            options.descriptorBenchmark = true;
+        } else if (arg == "--draw-order" && i + 1 < argc) {
+            std::string order = argv[++i];
+            if (order == "submission") {
+                options.drawOrder = DrawOrder::Submission;
+            } else if (order == "front-to-back") {
+                options.drawOrder = DrawOrder::FrontToBack;
+            } else if (order == "back-to-front") {
+                options.drawOrder = DrawOrder::BackToFront;
+            } else {
+                throw std::runtime_error("unknown draw order " + order + ", expected submission, front-to-back or back-to-front");
+            }
+        } else if (arg == "--depth-prepass") {
+            options.depthPrepass = true;
+        } else if (arg == "--depth-benchmark") {
+            options.depthBenchmark = true;
+        } else if (arg == "--textures" && i + 1 < argc) {
+            options.textureCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--texture-size" && i + 1 < argc) {
+            options.textureSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+            if (options.textureSize == 0 || (options.textureSize & (options.textureSize - 1)) != 0) {
+                throw std::runtime_error("--texture-size must be a power of two");
+            }
+        } else if (arg == "--texture-budget" && i + 1 < argc) {
+            options.textureBudgetMiB = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--vertex-format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format == "float") {
+                options.vertexFormat = VertexFormat::Float;
+            } else if (format == "packed") {
+                options.vertexFormat = VertexFormat::Packed;
+            } else if (format == "half") {
+                options.vertexFormat = VertexFormat::Half;
+            } else if (format == "snorm") {
+                options.vertexFormat = VertexFormat::Snorm;
+            } else {
+                throw std::runtime_error("unknown vertex format " + format + ", expected float, packed, half or snorm");
+            }
+        } else if (arg == "--present-policy" && i + 1 < argc) {
+            std::string policy = argv[++i];
+            if (policy == "lowest-latency") {
+                options.presentPolicy = PresentPolicy::LowestLatency;
+            } else if (policy == "low-latency") {
+                options.presentPolicy = PresentPolicy::LowLatency;
+            } else if (policy == "vsync") {
+                options.presentPolicy = PresentPolicy::Vsync;
+            } else if (policy == "throughput") {
+                options.presentPolicy = PresentPolicy::Throughput;
+            } else {
+                throw std::runtime_error("unknown present policy " + policy + ", expected lowest-latency, low-latency, vsync or throughput");
+            }
+        } else if (arg == "--fps-limit" && i + 1 < argc) {
+            options.fpsLimit = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--present-mode" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            options.presentModeOverride = true;
+            if (mode == "immediate") {
+                options.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            } else if (mode == "mailbox") {
+                options.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            } else if (mode == "fifo") {
+                options.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            } else if (mode == "fifo-relaxed") {
+                options.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            } else {
+                throw std::runtime_error("unknown present mode " + mode + ", expected immediate, mailbox, fifo or fifo-relaxed");
+            }
+        } else if (arg == "--pipeline-cache" && i + 1 < argc) {
+            options.pipelineCachePath = argv[++i];
+        } else if (arg == "--no-pipeline-cache") {
+            options.pipelineCachePath.clear();
+        } else if (arg == "--frames-in-flight" && i + 1 < argc) {
+            options.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+            if (options.framesInFlight == 0) {
+                throw std::runtime_error("--frames-in-flight must be at least 1");
+            }
+        } else {
+            throw std::runtime_error("unknown argument " + arg + "\n"
+                "usage: hello-triangle [--headless] [--frames <count>] [--frames-in-flight <count>]\n"
+                "                      [--pipeline-cache <path> | --no-pipeline-cache]\n"
+                "                      [--draw-calls <count>] [--recording-threads <count>] [--record-benchmark]\n"
+                "                      [--instances <count>] [--instance-benchmark]\n"
+                "                      [--grid <size> | --mesh <file.obj|file.mesh>]\n"
+                "                      [--profile] [--trace <path>]\n"
+                "                      [--benchmark [--seconds <seconds>] [--benchmark-output <file.json|file.csv>]]\n"
+                "                      [--present-policy lowest-latency|low-latency|vsync|throughput] [--fps-limit <fps>]\n"
+                "                      [--present-mode immediate|mailbox|fifo|fifo-relaxed]\n"
+                "                      [--wireframe] [--pipeline-benchmark] [--stream-vertices <count>]\n"
+                "                      [--vertex-kernel-benchmark] [--vertex-format float|packed|half|snorm]\n"
+                "                      [--gpu-culling | --cpu-culling] [--cull-benchmark]\n"
+                "                      [--object-data push|dynamic|sets|bindless] [--descriptor-benchmark]\n"
+                "                      [--textures <count> [--texture-size <texels>] [--texture-budget <MiB>]]\n"
+                "                      [--draw-order submission|front-to-back|back-to-front] [--depth-prepass] [--depth-benchmark]");
+        }
+    }
+
+    if ((options.gpuCulling || options.cpuCulling) && (options.streamVertexCount > 0 || options.instanceBenchmark)) {
+        throw std::runtime_error("culling draws the indexed mesh instances, it can't be combined with --stream-vertices or --instance-benchmark");
+    }
+    if (options.gridSize > 0 && !options.meshPath.empty()) {
+        throw std::runtime_error("--grid and --mesh are exclusive");
+    }
+    if (options.gpuCulling && options.cpuCulling) {
+        throw std::runtime_error("--gpu-culling and --cpu-culling are exclusive");
+    }
+    if (options.recordBenchmark && (options.gpuCulling || options.cpuCulling)) {
+        throw std::runtime_error("--record-benchmark records a draw per object, it can't be combined with culling");
+    }
+    if (options.descriptorBenchmark && (options.gpuCulling || options.cpuCulling)) {
+        throw std::runtime_error("--descriptor-benchmark needs a draw per object, it can't be combined with culling");
+    }
+    if (options.depthBenchmark && (options.gpuCulling || options.cpuCulling)) {
+        throw std::runtime_error("--depth-benchmark sorts a draw per object, it can't be combined with culling");
+    }
+    if (options.depthPrepass && (options.gpuCulling || options.cpuCulling)) {
+        throw std::runtime_error("--depth-prepass needs a draw per object, it can't be combined with culling");
+    }
+    if ((options.depthPrepass || options.depthBenchmark) && (options.instanceCount > 1 || options.instanceBenchmark)) {
+        throw std::runtime_error("the instances of an object share its depth, --depth-prepass and --depth-benchmark need a single instance");
+    }
+    if (options.textureCount > 0) {
+        // the instances find their texture's slot through the bindless table
+        if (options.descriptorBenchmark || (objectDataPathSet && options.objectDataPath != ObjectDataPath::Bindless)) {
+            throw std::runtime_error("--textures needs the bindless object data path, it can't be combined with other paths or --descriptor-benchmark");
+        }
+        options.objectDataPath = ObjectDataPath::Bindless;
+    }
+    if (options.recordBenchmark && !drawCountSet) {
+        // the objects are generated for every draw recorded, enough of them that recording takes a while
+        options.drawCount = 100000;
+    }
+    if (options.descriptorBenchmark && !drawCountSet) {
+        // a draw per object, enough of them that binding dominates the frame
+        options.drawCount = 10000;
+    }
+    if (options.depthBenchmark && !drawCountSet) {
+        // a thousand layers of overdraw over most of the mesh
+        options.drawCount = 1000;
+    }
+
+    return options;
+}
 
+int main(int argc, char* argv[]) {
     try {
+        HelloTriangleApplication app(parseOptions(argc, argv));
         app.run();
-    } catch (const std::runtime_error& e) {
+    } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
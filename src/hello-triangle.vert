@@ -1,16 +1,59 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// the depth prepass and the equal tested pass have to compute bitwise identical depths
 out gl_PerVertex {
-    vec4 gl_Position;
+    invariant vec4 gl_Position;
 };
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 
+layout(location = 2) in vec2 instanceOffset;
+layout(location = 3) in float instanceScale;
+layout(location = 4) in float instanceRotation;
+layout(location = 5) in vec3 instanceColor;
+
 layout(location = 0) out vec3 outColor;
 
+// written once per frame, bound at a dynamic offset into the frame's ring buffer region
+layout(set = 0, binding = 0) uniform Frame {
+    float time;
+} frame;
+
+struct ObjectData {
+    vec4 color;
+    vec2 offset;
+    // radians per second
+    float spin;
+    // in [0, 1], nearer is smaller
+    float depth;
+};
+
+// one per draw, selected with a dynamic offset or a descriptor set per object
+layout(set = 1, binding = 0) uniform Object {
+    ObjectData data;
+} object;
+
+layout(push_constant) uniform Push {
+    ObjectData object;
+    // 0 reads the object from the push constants, 1 from the object uniform buffer
+    uint objectSource;
+} push;
+
 void main() {
-    gl_Position = vec4(inPosition, 1.0);
-    outColor = inColor;
+    ObjectData objectData;
+    if (push.objectSource == 0) {
+        objectData = push.object;
+    } else {
+        objectData = object.data;
+    }
+
+    float rotation = instanceRotation + objectData.spin * frame.time;
+    float s = sin(rotation);
+    float c = cos(rotation);
+    vec2 position = mat2(c, s, -s, c) * inPosition.xy * instanceScale + instanceOffset + objectData.offset;
+
+    gl_Position = vec4(position, objectData.depth, 1.0);
+    outColor = inColor * instanceColor * objectData.color.rgb;
 }
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read only memory mapping of a whole file. Pages are only read from disk when touched, and the mapping
+// starts on a page boundary, so its contents can be reinterpreted as any naturally aligned type.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("failed to open file " + path);
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            close();
+            throw std::runtime_error("failed to query size of " + path);
+        }
+        size = static_cast<size_t>(fileSize.QuadPart);
+        // mapping an empty file fails, there is nothing to map anyway
+        if (size > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr) {
+                data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            }
+            if (data == nullptr) {
+                close();
+                throw std::runtime_error("failed to map file " + path);
+            }
+        }
+#else
+        int fileDescriptor = open(path.c_str(), O_RDONLY);
+        if (fileDescriptor < 0) {
+            throw std::runtime_error("failed to open file " + path);
+        }
+        struct stat fileStatus;
+        if (fstat(fileDescriptor, &fileStatus) != 0) {
+            ::close(fileDescriptor);
+            throw std::runtime_error("failed to query size of " + path);
+        }
+        size = static_cast<size_t>(fileStatus.st_size);
+        // mapping an empty file fails, there is nothing to map anyway
+        if (size > 0) {
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fileDescriptor);
+                throw std::runtime_error("failed to map file " + path);
+            }
+            data = mapped;
+        }
+        // the mapping keeps its own reference to the file
+        ::close(fileDescriptor);
+#endif
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(data, other.data);
+            std::swap(size, other.size);
+#ifdef _WIN32
+            std::swap(file, other.file);
+            std::swap(mapping, other.mapping);
+#endif
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const void* getData() const {
+        return data;
+    }
+
+    size_t getSize() const {
+        return size;
+    }
+
+private:
+    void close() {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+        file = INVALID_HANDLE_VALUE;
+        mapping = nullptr;
+#else
+        if (data != nullptr) {
+            munmap(const_cast<void*>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const void* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // points at offset inside the persistently mapped block, nullptr for memory that isn't host visible
+    void* mapped = nullptr;
+    uint32_t blockIndex = 0;
+};
+
+// Carves few large VkDeviceMemory blocks per memory type into suballocations instead of calling
+// vkAllocateMemory per resource, which quickly runs into maxMemoryAllocationCount.
+// Free space of every block is tracked as an offset ordered free list that is coalesced on free.
+class MemoryAllocator {
+public:
+    struct Stats {
+        size_t blockCount = 0;
+        size_t allocationCount = 0;
+        VkDeviceSize blockBytes = 0;
+        VkDeviceSize usedBytes = 0;
+        VkDeviceSize largestFreeRange = 0;
+        // 0 if all free memory is one contiguous range, approaching 1 the more it is scattered
+        double fragmentation = 0.0;
+    };
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device) {
+        this->device = device;
+
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        bufferImageGranularity = properties.limits.bufferImageGranularity;
+    }
+
+    void destroy() {
+        for (auto& block : blocks) {
+            if (block) {
+                vkFreeMemory(device, block->memory, nullptr);
+            }
+        }
+        blocks.clear();
+    }
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags) const {
+        for (uint32_t i = 0u; i < memoryProperties.memoryTypeCount; ++i) {
+            if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("failed to find suitable memory type");
+    }
+
+    bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags) const {
+        for (uint32_t i = 0u; i < memoryProperties.memoryTypeCount; ++i) {
+            if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Allocation allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags propertyFlags) {
+        VkMemoryRequirements memoryRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+        Allocation allocation = allocate(memoryRequirements, propertyFlags, false);
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+        return allocation;
+    }
+
+    Allocation allocateImage(VkImage image, VkMemoryPropertyFlags propertyFlags) {
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+        // only optimally tiled images are created, they must not share a bufferImageGranularity
+        // page with linear resources
+        Allocation allocation = allocate(memoryRequirements, propertyFlags, true);
+        vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+        return allocation;
+    }
+
+    Allocation allocate(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags propertyFlags, bool optimalImage) {
+        uint32_t memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, propertyFlags);
+
+        VkDeviceSize alignment = memoryRequirements.alignment;
+        VkDeviceSize size = memoryRequirements.size;
+        if (optimalImage) {
+            // padding images to whole granularity pages keeps any linear neighbour off their pages
+            alignment = std::max(alignment, bufferImageGranularity);
+            size = alignUp(size, bufferImageGranularity);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        VkDeviceSize blockSize = preferredBlockSize(memoryTypeIndex);
+        if (size > blockSize / 2) {
+            // large resources get a block of their own instead of wasting most of a shared one
+            uint32_t blockIndex = createBlock(memoryTypeIndex, size, true);
+            return allocateFromBlock(blockIndex, size, alignment);
+        }
+
+        for (uint32_t i = 0; i < blocks.size(); ++i) {
+            if (blocks[i] && !blocks[i]->dedicated && blocks[i]->memoryTypeIndex == memoryTypeIndex) {
+                Allocation allocation = allocateFromBlock(i, size, alignment);
+                if (allocation.memory != VK_NULL_HANDLE) {
+                    return allocation;
+                }
+            }
+        }
+
+        uint32_t blockIndex = createBlock(memoryTypeIndex, blockSize, false);
+        return allocateFromBlock(blockIndex, size, alignment);
+    }
+
+    void free(Allocation& allocation) {
+        if (allocation.memory == VK_NULL_HANDLE) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Block& block = *blocks[allocation.blockIndex];
+        --block.allocationCount;
+        block.usedBytes -= allocation.size;
+
+        if (block.dedicated && block.allocationCount == 0) {
+            vkFreeMemory(device, block.memory, nullptr);
+            blocks[allocation.blockIndex].reset();
+            allocation = {};
+            return;
+        }
+
+        VkDeviceSize offset = allocation.offset;
+        VkDeviceSize size = allocation.size;
+
+        // merge with the following free range
+        auto next = block.freeRanges.lower_bound(offset);
+        if (next != block.freeRanges.end() && offset + size == next->first) {
+            size += next->second;
+            next = block.freeRanges.erase(next);
+        }
+        // merge with the preceding free range
+        if (next != block.freeRanges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                previous->second += size;
+                allocation = {};
+                return;
+            }
+        }
+        block.freeRanges.emplace(offset, size);
+
+        allocation = {};
+    }
+
+    Stats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Stats stats;
+        VkDeviceSize freeBytes = 0;
+        for (const auto& block : blocks) {
+            if (!block) {
+                continue;
+            }
+            ++stats.blockCount;
+            stats.allocationCount += block->allocationCount;
+            stats.blockBytes += block->size;
+            stats.usedBytes += block->usedBytes;
+            for (const auto& range : block->freeRanges) {
+                freeBytes += range.second;
+                stats.largestFreeRange = std::max(stats.largestFreeRange, range.second);
+            }
+        }
+        if (freeBytes > 0) {
+            stats.fragmentation = 1.0 - static_cast<double>(stats.largestFreeRange) / freeBytes;
+        }
+        return stats;
+    }
+
+private:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    struct Block {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        void* mapped;
+        uint32_t memoryTypeIndex;
+        bool dedicated;
+        size_t allocationCount;
+        VkDeviceSize usedBytes;
+        // offset -> size of every free range, ordered by offset for coalescing
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+    };
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    VkDeviceSize preferredBlockSize(uint32_t memoryTypeIndex) const {
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+        // small heaps, like the host visible bar of discrete gpus, would be used up by a handful of blocks
+        return std::min(DEFAULT_BLOCK_SIZE, heapSize / 8);
+    }
+
+    uint32_t createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated) {
+        auto block = std::make_unique<Block>();
+        block->size = size;
+        block->mapped = nullptr;
+        block->memoryTypeIndex = memoryTypeIndex;
+        block->dedicated = dedicated;
+        block->allocationCount = 0;
+        block->usedBytes = 0;
+        block->freeRanges.emplace(0, size);
+
+        VkMemoryAllocateInfo memoryAllocateInfo = {};
+        memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memoryAllocateInfo.allocationSize = size;
+        memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+        if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &block->memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate device memory block");
+        }
+
+        // host visible blocks stay mapped for their whole lifetime, suballocations just offset into them
+        if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(device, block->memory, 0, size, 0, &block->mapped) != VK_SUCCESS) {
+                vkFreeMemory(device, block->memory, nullptr);
+                throw std::runtime_error("failed to map device memory block");
+            }
+        }
+
+        for (uint32_t i = 0; i < blocks.size(); ++i) {
+            if (!blocks[i]) {
+                blocks[i] = std::move(block);
+                return i;
+            }
+        }
+        blocks.push_back(std::move(block));
+        return static_cast<uint32_t>(blocks.size() - 1);
+    }
+
+    // first fit, returns an empty allocation if the block has no range large enough
+    Allocation allocateFromBlock(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment) {
+        Block& block = *blocks[blockIndex];
+
+        for (auto range = block.freeRanges.begin(); range != block.freeRanges.end(); ++range) {
+            VkDeviceSize rangeOffset = range->first;
+            VkDeviceSize rangeSize = range->second;
+            VkDeviceSize alignedOffset = alignUp(rangeOffset, alignment);
+            if (alignedOffset + size > rangeOffset + rangeSize) {
+                continue;
+            }
+
+            block.freeRanges.erase(range);
+            // the alignment padding in front and the remainder behind stay free
+            if (alignedOffset > rangeOffset) {
+                block.freeRanges.emplace(rangeOffset, alignedOffset - rangeOffset);
+            }
+            if (alignedOffset + size < rangeOffset + rangeSize) {
+                block.freeRanges.emplace(alignedOffset + size, rangeOffset + rangeSize - alignedOffset - size);
+            }
+
+            ++block.allocationCount;
+            block.usedBytes += size;
+
+            Allocation allocation;
+            allocation.memory = block.memory;
+            allocation.offset = alignedOffset;
+            allocation.size = size;
+            allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + alignedOffset : nullptr;
+            allocation.blockIndex = blockIndex;
+            return allocation;
+        }
+
+        return {};
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+    VkDeviceSize bufferImageGranularity = 1;
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Block>> blocks;
+};
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mesh-file.h"
+#include "mesh.h"
+#include "obj-loader.h"
+#include "vertex-kernels.h"
+#include "vertex-layout.h"
+
+// Converts an OBJ mesh into the binary mesh format hello-triangle maps with --mesh, optimized for the vertex
+// cache and stored in the vertex format it is going to be drawn with.
+
+namespace {
+
+bool endsWith(const std::string& value, const std::string& suffix) {
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+template<typename GpuVertex>
+void writeConverted(const std::string& path, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, float radius) {
+    VertexStream stream;
+    copyToVertexStream(vertices.data(), vertices.size(), stream);
+    std::vector<GpuVertex> converted(vertices.size());
+    packVertexStream(stream, converted.data());
+    writeMeshFile(path, converted, indices, radius);
+}
+
+void convert(const std::string& inputPath, const std::string& outputPath, VertexFormat vertexFormat) {
+    if (endsWith(inputPath, ".gltf") || endsWith(inputPath, ".glb")) {
+        throw std::runtime_error("glTF input is not supported, export the mesh as OBJ");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Vertex> triangleList = loadObj(inputPath);
+    auto parsed = std::chrono::steady_clock::now();
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    deduplicateVertices(triangleList, vertices, indices);
+    double acmrBefore = computeAcmr(indices, vertices.size());
+    optimizeVertexCache(indices, vertices.size());
+    optimizeVertexFetch(vertices, indices);
+    double acmrAfter = computeAcmr(indices, vertices.size());
+
+    float radius = 0.0f;
+    for (const Vertex& vertex : vertices) {
+        radius = std::max(radius, glm::length(vertex.position));
+        if (vertexFormat == VertexFormat::Snorm && (std::abs(vertex.position.x) > 1.0f || std::abs(vertex.position.y) > 1.0f)) {
+            throw std::runtime_error("mesh positions outside [-1, 1] can't be stored as snorm");
+        }
+    }
+
+    switch (vertexFormat) {
+    case VertexFormat::Float:
+        writeMeshFile(outputPath, vertices, indices, radius);
+        break;
+    case VertexFormat::Packed:
+        writeConverted<PackedVertex>(outputPath, vertices, indices, radius);
+        break;
+    case VertexFormat::Half:
+        writeConverted<HalfVertex>(outputPath, vertices, indices, radius);
+        break;
+    case VertexFormat::Snorm:
+        writeConverted<SnormVertex>(outputPath, vertices, indices, radius);
+        break;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << inputPath << " -> " << outputPath << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, "
+              << vertexFormatName(vertexFormat) << " vertices, ACMR " << acmrBefore << " -> " << acmrAfter << ", parsed in "
+              << std::chrono::duration<double, std::milli>(parsed - start).count() << " ms, converted in "
+              << std::chrono::duration<double, std::milli>(end - parsed).count() << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string inputPath;
+    std::string outputPath;
+    VertexFormat vertexFormat = VertexFormat::Float;
+    bool validArguments = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--vertex-format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format == "float") {
+                vertexFormat = VertexFormat::Float;
+            } else if (format == "packed") {
+                vertexFormat = VertexFormat::Packed;
+            } else if (format == "half") {
+                vertexFormat = VertexFormat::Half;
+            } else if (format == "snorm") {
+                vertexFormat = VertexFormat::Snorm;
+            } else {
+                validArguments = false;
+            }
+        } else if (inputPath.empty()) {
+            inputPath = arg;
+        } else if (outputPath.empty()) {
+            outputPath = arg;
+        } else {
+            validArguments = false;
+        }
+    }
+    if (!validArguments || outputPath.empty()) {
+        std::cerr << "usage: mesh-converter <input.obj> <output.mesh> [--vertex-format float|packed|half|snorm]\n"
+                     "the vertex format must match the one hello-triangle is run with" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        convert(inputPath, outputPath, vertexFormat);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
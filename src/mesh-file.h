@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "mapped-file.h"
+#include "vertex-layout.h"
+
+// Binary mesh container written by mesh-converter. A fixed size header describing the vertex layout is
+// followed by the vertex and index data exactly as the gpu reads them, each starting at a multiple of
+// MESH_FILE_ALIGNMENT, so a memory mapped file is copied straight into a staging buffer without parsing.
+// Stored little endian, like every platform the renderer runs on.
+
+// "MESH"
+const uint32_t MESH_FILE_MAGIC = 0x4853454d;
+const uint32_t MESH_FILE_VERSION = 1;
+const uint32_t MESH_FILE_MAX_ATTRIBUTES = 8;
+// covers optimalBufferCopyOffsetAlignment and nonCoherentAtomSize of current devices
+const uint64_t MESH_FILE_ALIGNMENT = 256;
+
+struct MeshFileAttribute {
+    // a VkFormat
+    uint32_t format;
+    uint32_t offset;
+};
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t vertexStride;
+    uint32_t attributeCount;
+    // bytes per index, 2 or 4
+    uint32_t indexSize;
+    // distance of the furthest vertex from the origin
+    float radius;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    // in location order
+    MeshFileAttribute attributes[MESH_FILE_MAX_ATTRIBUTES];
+};
+
+static_assert(sizeof(MeshFileHeader) == 112, "the header layout is part of the file format");
+
+// the parts of a mesh file, pointing into its mapping
+struct MeshFileView {
+    const MeshFileHeader* header = nullptr;
+    const void* vertexData = nullptr;
+    uint64_t vertexBytes = 0;
+    const void* indexData = nullptr;
+    uint64_t indexBytes = 0;
+};
+
+// the largest index, a max reduction the compiler vectorizes
+template<typename Index>
+uint32_t getMaxIndex(const void* data, uint32_t count) {
+    const Index* indices = static_cast<const Index*>(data);
+    Index maximum = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        maximum = std::max(maximum, indices[i]);
+    }
+    return maximum;
+}
+
+inline MeshFileView viewMeshFile(const MappedFile& file, const std::string& path) {
+    if (file.getSize() < sizeof(MeshFileHeader)) {
+        throw std::runtime_error(path + " is too small to be a mesh file");
+    }
+    const char* data = static_cast<const char*>(file.getData());
+    // mappings start on a page boundary, the header can be read in place
+    const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(data);
+    if (header->magic != MESH_FILE_MAGIC) {
+        throw std::runtime_error(path + " is not a mesh file");
+    }
+    if (header->version != MESH_FILE_VERSION) {
+        throw std::runtime_error(path + " has mesh file version " + std::to_string(header->version) + ", expected "
+                                 + std::to_string(MESH_FILE_VERSION) + ", convert it again");
+    }
+    if (header->vertexCount == 0 || header->indexCount == 0 || header->attributeCount > MESH_FILE_MAX_ATTRIBUTES
+        || (header->indexSize != 2 && header->indexSize != 4)) {
+        throw std::runtime_error(path + " has an invalid mesh file header");
+    }
+
+    MeshFileView view;
+    view.header = header;
+    view.vertexBytes = static_cast<uint64_t>(header->vertexCount) * header->vertexStride;
+    view.indexBytes = static_cast<uint64_t>(header->indexCount) * header->indexSize;
+    // written so that no offset can wrap around
+    auto fitsInFile = [&file](uint64_t offset, uint64_t bytes) {
+        return offset <= file.getSize() && bytes <= file.getSize() - offset;
+    };
+    if (header->vertexOffset % MESH_FILE_ALIGNMENT != 0 || header->indexOffset % MESH_FILE_ALIGNMENT != 0
+        || !fitsInFile(header->vertexOffset, view.vertexBytes) || !fitsInFile(header->indexOffset, view.indexBytes)) {
+        throw std::runtime_error(path + " is truncated or has invalid offsets");
+    }
+    view.vertexData = data + header->vertexOffset;
+    view.indexData = data + header->indexOffset;
+
+    // the indices are uploaded as they are, one past the vertices would have the gpu read out of bounds
+    uint32_t maxIndex = header->indexSize == 2 ? getMaxIndex<uint16_t>(view.indexData, header->indexCount)
+                                               : getMaxIndex<uint32_t>(view.indexData, header->indexCount);
+    if (maxIndex >= header->vertexCount) {
+        throw std::runtime_error(path + " has indices past its " + std::to_string(header->vertexCount) + " vertices");
+    }
+    return view;
+}
+
+// true if the file's vertices can be used as GpuVertex without conversion
+template<typename GpuVertex>
+bool hasVertexLayout(const MeshFileHeader& header) {
+    const auto& attributes = VertexLayout<GpuVertex>::attributes;
+    if (header.vertexStride != sizeof(GpuVertex) || header.attributeCount != attributes.size()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < attributes.size(); ++i) {
+        if (header.attributes[i].format != static_cast<uint32_t>(attributes[i].format) || header.attributes[i].offset != attributes[i].offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 16 bit indices whenever the vertices allow it
+template<typename GpuVertex>
+void writeMeshFile(const std::string& path, const std::vector<GpuVertex>& vertices, const std::vector<uint32_t>& indices, float radius) {
+    static_assert(isValidVertexLayout<GpuVertex>(), "vertex layout doesn't match the vertex struct");
+    const auto& attributes = VertexLayout<GpuVertex>::attributes;
+    static_assert(attributes.size() <= MESH_FILE_MAX_ATTRIBUTES, "too many vertex attributes for the mesh file header");
+
+    auto alignUp = [](uint64_t value) {
+        return (value + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+    };
+
+    MeshFileHeader header = {};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.vertexCount = static_cast<uint32_t>(vertices.size());
+    header.indexCount = static_cast<uint32_t>(indices.size());
+    header.vertexStride = sizeof(GpuVertex);
+    header.attributeCount = static_cast<uint32_t>(attributes.size());
+    header.indexSize = vertices.size() <= UINT16_MAX ? 2 : 4;
+    header.radius = radius;
+    header.vertexOffset = alignUp(sizeof(header));
+    header.indexOffset = alignUp(header.vertexOffset + vertices.size() * sizeof(GpuVertex));
+    for (uint32_t i = 0; i < attributes.size(); ++i) {
+        header.attributes[i] = {static_cast<uint32_t>(attributes[i].format), attributes[i].offset};
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("failed to open " + path + " for writing");
+    }
+    const std::vector<char> padding(MESH_FILE_ALIGNMENT, 0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding.data(), header.vertexOffset - sizeof(header));
+    file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(GpuVertex));
+    file.write(padding.data(), header.indexOffset - header.vertexOffset - vertices.size() * sizeof(GpuVertex));
+    if (header.indexSize == 2) {
+        std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+        file.write(reinterpret_cast<const char*>(shortIndices.data()), shortIndices.size() * sizeof(uint16_t));
+    } else {
+        file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+    }
+    if (!file) {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
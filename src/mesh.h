@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// FIFO size the post-transform vertex cache is modelled with, a conservative guess for current hardware
+const uint32_t VERTEX_CACHE_SIZE = 16;
+
+// Turns a triangle list with repeated vertices into unique vertices plus indices. Vertices are compared
+// bitwise, so the vertex type must not contain padding.
+template<typename VertexType>
+void deduplicateVertices(const std::vector<VertexType>& triangleList, std::vector<VertexType>& vertices, std::vector<uint32_t>& indices) {
+    // keyed by the raw bytes, hashing and comparing them doesn't need anything from the vertex type
+    std::unordered_map<std::string, uint32_t> uniqueVertices;
+    uniqueVertices.reserve(triangleList.size());
+
+    vertices.clear();
+    indices.clear();
+    indices.reserve(triangleList.size());
+
+    for (const auto& vertex : triangleList) {
+        std::string key(reinterpret_cast<const char*>(&vertex), sizeof(VertexType));
+        auto inserted = uniqueVertices.emplace(std::move(key), static_cast<uint32_t>(vertices.size()));
+        if (inserted.second) {
+            vertices.push_back(vertex);
+        }
+        indices.push_back(inserted.first->second);
+    }
+}
+
+// Average cache miss ratio, vertex shader invocations per triangle of a FIFO cache. 0.5 is the optimum
+// for large regular meshes, 3 means no reuse at all.
+inline double computeAcmr(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE) {
+    if (indices.empty()) {
+        return 0.0;
+    }
+
+    // a vertex is cached while fewer than cacheSize misses happened since its own miss
+    std::vector<uint64_t> missTime(vertexCount, 0);
+    uint64_t misses = 0;
+    for (uint32_t index : indices) {
+        if (missTime[index] == 0 || misses - missTime[index] >= cacheSize) {
+            missTime[index] = ++misses;
+        }
+    }
+    return static_cast<double>(misses) / (indices.size() / 3);
+}
+
+// Reorders triangles for post-transform vertex cache reuse with Tipsify (Sander, Nehab, Barczak 2007):
+// fans around one vertex at a time and picks the next fanning vertex among the ones just emitted that
+// will still be in the cache once its remaining triangles are drawn.
+inline void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // triangles adjacent to every vertex, packed into one array
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices) {
+        ++liveTriangles[index];
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < vertexCount; ++i) {
+        adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangles[i];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        adjacency[adjacencyFill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<uint64_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    uint64_t timestamp = cacheSize + 1;
+    size_t cursor = 0;
+
+    std::vector<uint32_t> optimized;
+    optimized.reserve(indices.size());
+
+    int64_t fanningVertex = indices[0];
+    while (fanningVertex >= 0) {
+        candidates.clear();
+
+        for (uint32_t i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; ++i) {
+            uint32_t triangle = adjacency[i];
+            if (emitted[triangle]) {
+                continue;
+            }
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                uint32_t vertex = indices[triangle * 3 + corner];
+                optimized.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                --liveTriangles[vertex];
+                if (timestamp - cacheTime[vertex] > cacheSize) {
+                    cacheTime[vertex] = timestamp++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // prefer the oldest candidate that stays cached while its remaining triangles are emitted
+        fanningVertex = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t vertex : candidates) {
+            if (liveTriangles[vertex] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (timestamp - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+                priority = static_cast<int64_t>(timestamp - cacheTime[vertex]);
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanningVertex = vertex;
+            }
+        }
+
+        // dead end, continue with the most recently emitted vertex that still has triangles left,
+        // otherwise with the next one in input order
+        while (fanningVertex < 0 && !deadEnd.empty()) {
+            uint32_t vertex = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[vertex] > 0) {
+                fanningVertex = vertex;
+            }
+        }
+        while (fanningVertex < 0 && cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0) {
+                fanningVertex = static_cast<int64_t>(cursor);
+            }
+            ++cursor;
+        }
+    }
+
+    indices.swap(optimized);
+}
+
+// Renumbers vertices in the order the indices first reference them, so vertex fetches walk memory linearly.
+template<typename VertexType>
+void optimizeVertexFetch(std::vector<VertexType>& vertices, std::vector<uint32_t>& indices) {
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<VertexType> reordered;
+    reordered.reserve(vertices.size());
+
+    for (auto& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(reordered);
+}
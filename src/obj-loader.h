@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vertex-layout.h"
+
+// Reads the triangles of a Wavefront OBJ file as a triangle list. Positions are projected onto the xy plane,
+// centered and scaled to fit [-0.5, 0.5] like the built in meshes, and colored with the optional per vertex
+// color extension (v x y z r g b), white otherwise. Polygons are triangulated as fans, texture coordinates,
+// normals, groups and materials are ignored.
+inline std::vector<Vertex> loadObj(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("failed to open file " + path);
+    }
+
+    std::vector<Vertex> positions;
+    std::vector<Vertex> triangleList;
+    std::vector<uint32_t> polygon;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        const char* cursor = line.c_str();
+        if (cursor[0] == 'v' && cursor[1] == ' ') {
+            float values[6] = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+            cursor += 2;
+            int count = 0;
+            for (; count < 6; ++count) {
+                char* end;
+                float value = std::strtof(cursor, &end);
+                if (end == cursor) {
+                    break;
+                }
+                values[count] = value;
+                cursor = end;
+            }
+            if (count < 3) {
+                throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": vertex with fewer than 3 coordinates");
+            }
+            // a 4th coordinate without a color is w, keep the white default
+            if (count < 6) {
+                values[3] = values[4] = values[5] = 1.0f;
+            }
+            positions.push_back({{values[0], values[1]}, {values[3], values[4], values[5]}});
+        } else if (cursor[0] == 'f' && cursor[1] == ' ') {
+            polygon.clear();
+            cursor += 2;
+            while (true) {
+                char* end;
+                long index = std::strtol(cursor, &end, 10);
+                if (end == cursor) {
+                    break;
+                }
+                // negative indices count back from the last vertex read so far
+                long resolved = index < 0 ? static_cast<long>(positions.size()) + index : index - 1;
+                if (index == 0 || resolved < 0 || resolved >= static_cast<long>(positions.size())) {
+                    throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": face references a missing vertex");
+                }
+                polygon.push_back(static_cast<uint32_t>(resolved));
+                // skip /vt/vn
+                cursor = end;
+                while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t') {
+                    ++cursor;
+                }
+            }
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                triangleList.push_back(positions[polygon[0]]);
+                triangleList.push_back(positions[polygon[i - 1]]);
+                triangleList.push_back(positions[polygon[i]]);
+            }
+        }
+    }
+    if (triangleList.empty()) {
+        throw std::runtime_error(path + " contains no faces");
+    }
+
+    glm::vec2 minimum(std::numeric_limits<float>::max());
+    glm::vec2 maximum(std::numeric_limits<float>::lowest());
+    for (const Vertex& vertex : triangleList) {
+        minimum = glm::min(minimum, vertex.position);
+        maximum = glm::max(maximum, vertex.position);
+    }
+    const glm::vec2 center = (minimum + maximum) * 0.5f;
+    const float extent = std::max(maximum.x - minimum.x, maximum.y - minimum.y);
+    const float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+    for (Vertex& vertex : triangleList) {
+        vertex.position = (vertex.position - center) * scale;
+    }
+    return triangleList;
+}
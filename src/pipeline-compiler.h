@@ -0,0 +1,152 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "thread-pool.h"
+
+enum class BlendMode : uint8_t {
+    Opaque,
+    Alpha,
+    Additive
+};
+
+enum class DepthMode : uint8_t {
+    // no depth test, later draws cover earlier ones
+    Off,
+    // nearer fragments win and write their depth
+    TestAndWrite,
+    // depth only, no fragment shader or color writes, the first half of a depth prepass
+    Prepass,
+    // shades the fragments the prepass left visible, without writing depth
+    Equal
+};
+
+// The fixed function state that varies between pipeline permutations, everything else is shared.
+struct PipelineKey {
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    BlendMode blendMode = BlendMode::Opaque;
+    DepthMode depthMode = DepthMode::TestAndWrite;
+
+    bool operator==(const PipelineKey& other) const {
+        return topology == other.topology
+            && polygonMode == other.polygonMode
+            && cullMode == other.cullMode
+            && blendMode == other.blendMode
+            && depthMode == other.depthMode;
+    }
+};
+
+struct PipelineKeyHash {
+    size_t operator()(const PipelineKey& key) const {
+        // every field fits in 8 bits, the modes in 4
+        return static_cast<size_t>(key.topology)
+            | static_cast<size_t>(key.polygonMode) << 8
+            | static_cast<size_t>(key.cullMode) << 16
+            | static_cast<size_t>(key.blendMode) << 24
+            | static_cast<size_t>(key.depthMode) << 28;
+    }
+};
+
+// Compiles pipeline permutations on a thread pool. Each key is compiled once, however often it is
+// requested, and callers keep drawing with a fallback pipeline until the permutation is ready.
+// The create function is called on worker threads, a VkPipelineCache shared by it is internally synchronized.
+class PipelineCompiler {
+public:
+    using CreateFunction = std::function<VkPipeline(const PipelineKey&)>;
+
+    void init(VkDevice device, ThreadPool& threadPool, CreateFunction createPipeline) {
+        this->device = device;
+        this->threadPool = &threadPool;
+        this->createPipeline = std::move(createPipeline);
+    }
+
+    // waits for compilations in flight and destroys every pipeline
+    void destroy() {
+        for (VkPipeline pipeline : release()) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+    }
+
+    // waits for compilations in flight and hands over every pipeline, for when the render pass they
+    // were compiled against is replaced and they have to outlive the frames still using them
+    std::vector<VkPipeline> release() {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::vector<VkPipeline> released;
+        for (auto& entry : pipelines) {
+            VkPipeline pipeline = resolve(entry.second);
+            if (pipeline != VK_NULL_HANDLE) {
+                released.push_back(pipeline);
+            }
+        }
+        pipelines.clear();
+        return released;
+    }
+
+    void request(const PipelineKey& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        requestLocked(key);
+    }
+
+    // the compiled permutation if it is ready, otherwise the fallback, never blocks
+    VkPipeline get(const PipelineKey& key, VkPipeline fallback) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::shared_future<VkPipeline>& pipeline = requestLocked(key);
+        if (pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return fallback;
+        }
+        VkPipeline ready = resolve(pipeline);
+        return ready != VK_NULL_HANDLE ? ready : fallback;
+    }
+
+    // blocks until the permutation is compiled, VK_NULL_HANDLE if compiling it failed
+    VkPipeline wait(const PipelineKey& key) {
+        std::shared_future<VkPipeline> pipeline;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pipeline = requestLocked(key);
+        }
+        return resolve(pipeline);
+    }
+
+private:
+    std::shared_future<VkPipeline>& requestLocked(const PipelineKey& key) {
+        auto found = pipelines.find(key);
+        if (found != pipelines.end()) {
+            return found->second;
+        }
+
+        CreateFunction& create = createPipeline;
+        auto compiled = threadPool->submit([&create, key]() { return create(key); }).share();
+        return pipelines.emplace(key, std::move(compiled)).first->second;
+    }
+
+    // failed compilations leave their users on the fallback
+    static VkPipeline resolve(const std::shared_future<VkPipeline>& pipeline) {
+        try {
+            return pipeline.get();
+        } catch (const std::exception&) {
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    ThreadPool* threadPool = nullptr;
+    CreateFunction createPipeline;
+
+    std::mutex mutex;
+    std::unordered_map<PipelineKey, std::shared_future<VkPipeline>, PipelineKeyHash> pipelines;
+};
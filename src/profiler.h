@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Collects named durations from the cpu and gpu timeline into rolling windows for min/avg/p99 summaries,
+// and optionally streams them as Chrome trace events (chrome://tracing, ui.perfetto.dev).
+// Not thread safe, everything is expected to be recorded from the render thread.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Track {
+        Cpu = 1,
+        Gpu = 2
+    };
+
+    struct Summary {
+        double min;
+        double avg;
+        double p99;
+        size_t samples;
+    };
+
+    class ScopedTimer {
+    public:
+        ScopedTimer(Profiler& profiler, const char* name) : profiler(profiler), name(name) {
+            if (profiler.enabled) {
+                start = Clock::now();
+            }
+        }
+
+        ~ScopedTimer() {
+            if (profiler.enabled) {
+                profiler.record(name, Track::Cpu, start, Clock::now());
+            }
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Profiler& profiler;
+        const char* name;
+        Clock::time_point start;
+    };
+
+    explicit Profiler(size_t windowSize = 300) : windowSize(windowSize), epoch(Clock::now()) {}
+
+    ~Profiler() {
+        closeTrace();
+    }
+
+    void setEnabled(bool enabled) {
+        this->enabled = enabled;
+    }
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    // drops every sample, so following summaries only cover what is recorded from now on
+    void clear() {
+        series.clear();
+    }
+
+    ScopedTimer scope(const char* name) {
+        return ScopedTimer(*this, name);
+    }
+
+    void openTrace(const std::string& path) {
+        trace.open(path, std::ios::trunc);
+        if (!trace) {
+            throw std::runtime_error("failed to open trace file " + path);
+        }
+        trace << "{\"traceEvents\":[\n";
+        trace << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << static_cast<int>(Track::Cpu) << ",\"args\":{\"name\":\"cpu\"}},\n";
+        trace << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << static_cast<int>(Track::Gpu) << ",\"args\":{\"name\":\"gpu\"}}";
+    }
+
+    void closeTrace() {
+        if (trace.is_open()) {
+            trace << "\n]}\n";
+            trace.close();
+        }
+    }
+
+    void record(const std::string& name, Track track, Clock::time_point start, Clock::time_point end) {
+        if (!enabled) {
+            return;
+        }
+
+        double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+        Series& series = this->series[name];
+        if (series.samples.size() < windowSize) {
+            series.samples.push_back(milliseconds);
+        } else {
+            series.samples[series.next] = milliseconds;
+        }
+        series.next = (series.next + 1) % windowSize;
+
+        if (trace.is_open()) {
+            std::streamsize precision = trace.precision();
+            double startMicroseconds = std::chrono::duration<double, std::micro>(start - epoch).count();
+            trace << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << static_cast<int>(track)
+                  << ",\"ts\":" << std::fixed << std::setprecision(3) << startMicroseconds
+                  << ",\"dur\":" << milliseconds * 1000.0 << "}";
+            trace.unsetf(std::ios::floatfield);
+            trace.precision(precision);
+        }
+    }
+
+    Summary summarize(const std::string& name) const {
+        auto found = series.find(name);
+        if (found == series.end() || found->second.samples.empty()) {
+            return {0.0, 0.0, 0.0, 0};
+        }
+
+        std::vector<double> sorted = found->second.samples;
+        std::sort(sorted.begin(), sorted.end());
+
+        Summary summary;
+        summary.samples = sorted.size();
+        summary.min = sorted.front();
+        summary.avg = 0.0;
+        for (double sample : sorted) {
+            summary.avg += sample;
+        }
+        summary.avg /= sorted.size();
+        summary.p99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+        return summary;
+    }
+
+    void printSummary(std::ostream& out) const {
+        std::streamsize precision = out.precision();
+        size_t nameWidth = 0;
+        for (const auto& entry : series) {
+            nameWidth = std::max(nameWidth, entry.first.size());
+        }
+
+        out << std::left << std::setw(nameWidth) << "" << std::right
+            << std::setw(10) << "min" << std::setw(10) << "avg" << std::setw(10) << "p99"
+            << "  (ms, last " << windowSize << " samples)\n";
+        for (const auto& entry : series) {
+            Summary summary = summarize(entry.first);
+            out << std::left << std::setw(nameWidth) << entry.first << std::right << std::fixed << std::setprecision(3)
+                << std::setw(10) << summary.min << std::setw(10) << summary.avg << std::setw(10) << summary.p99 << "\n";
+        }
+        out.unsetf(std::ios::floatfield);
+        out.precision(precision);
+        out << std::flush;
+    }
+
+private:
+    struct Series {
+        std::vector<double> samples;
+        size_t next = 0;
+    };
+
+    const size_t windowSize;
+    const Clock::time_point epoch;
+    bool enabled = false;
+    std::map<std::string, Series> series;
+    std::ofstream trace;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+
+#include <vulkan/vulkan.h>
+
+// Persistently mapped buffer that hands out per frame regions for data the cpu rewrites every frame.
+// Regions are allocated linearly and wrap around at the end. A frame's regions become free once the
+// frame is known to be complete on the gpu, so the cpu writes the current frame while the gpu still
+// reads earlier ones, without mapping or waiting.
+class RingBuffer {
+public:
+    struct Region {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        void* data;
+    };
+
+    // mapped points at the start of buffer, in host visible and coherent memory
+    void init(VkBuffer buffer, VkDeviceSize size, void* mapped) {
+        if (mapped == nullptr) {
+            throw std::runtime_error("ring buffer memory must be host visible");
+        }
+        this->buffer = buffer;
+        this->mapped = static_cast<char*>(mapped);
+        this->capacity = size;
+    }
+
+    VkDeviceSize getCapacity() const {
+        return capacity;
+    }
+
+    Region allocate(VkDeviceSize size, VkDeviceSize alignment = 1) {
+        if (usedBytes == 0) {
+            // nothing in flight, start over at the front
+            head = 0;
+            tail = 0;
+        }
+
+        VkDeviceSize offset = alignUp(head, alignment);
+        VkDeviceSize consumed = 0;
+        if (head >= tail && (usedBytes == 0 || head != tail)) {
+            // free space is behind the head up to the end, and in front of the tail
+            if (offset + size <= capacity) {
+                consumed = offset + size - head;
+            } else if (size <= tail) {
+                // the rest of the buffer is skipped
+                consumed = capacity - head + size;
+                offset = 0;
+            } else {
+                throw std::runtime_error("ring buffer exhausted, too much data in flight");
+            }
+        } else {
+            // free space is between head and tail
+            if (offset + size > tail) {
+                throw std::runtime_error("ring buffer exhausted, too much data in flight");
+            }
+            consumed = offset + size - head;
+        }
+
+        head = offset + size;
+        usedBytes += consumed;
+        frameBytes += consumed;
+        return {buffer, offset, mapped + offset};
+    }
+
+    // everything allocated since the last call belongs to this frame
+    void finishFrame(uint64_t frameNumber) {
+        // empty frames have nothing to free, and keeping them would hold on to a stale tail
+        if (frameBytes > 0) {
+            frames.push_back({frameNumber, head, frameBytes});
+        }
+        frameBytes = 0;
+    }
+
+    // frees the regions of every frame up to and including completedFrame
+    void retire(uint64_t completedFrame) {
+        while (!frames.empty() && frames.front().frameNumber <= completedFrame) {
+            tail = frames.front().end;
+            usedBytes -= frames.front().bytes;
+            frames.pop_front();
+        }
+    }
+
+private:
+    struct FrameRange {
+        uint64_t frameNumber;
+        VkDeviceSize end;
+        VkDeviceSize bytes;
+    };
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    char* mapped = nullptr;
+    VkDeviceSize capacity = 0;
+
+    VkDeviceSize head = 0;
+    VkDeviceSize tail = 0;
+    // including padding and the skipped end of the buffer when wrapping
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize frameBytes = 0;
+    std::deque<FrameRange> frames;
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "mapped-file.h"
+#include "thread-pool.h"
+
+// Loads SPIR-V shader modules on a thread pool. Every file is loaded once, and files with identical
+// contents share one VkShaderModule. The returned futures let pipeline creation wait for exactly
+// the modules it needs, while the rest keep loading.
+class ShaderLibrary {
+public:
+    static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+    struct Stats {
+        size_t requestedFiles = 0;
+        size_t uniqueModules = 0;
+    };
+
+    void init(VkDevice device, ThreadPool& threadPool) {
+        this->device = device;
+        this->threadPool = &threadPool;
+    }
+
+    // waits for loads still in flight, then destroys every module
+    void destroy() {
+        for (auto& entry : files) {
+            entry.second.wait();
+        }
+        files.clear();
+
+        for (const auto& entry : modules) {
+            vkDestroyShaderModule(device, entry.second.module, nullptr);
+        }
+        modules.clear();
+    }
+
+    // must be called from one thread, the loading itself happens on the pool
+    std::shared_future<VkShaderModule> load(const std::string& path) {
+        auto found = files.find(path);
+        if (found != files.end()) {
+            return found->second;
+        }
+
+        std::shared_future<VkShaderModule> module = threadPool->submit([this, path]() { return loadModule(path); }).share();
+        files.emplace(path, module);
+        return module;
+    }
+
+    Stats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return {files.size(), modules.size()};
+    }
+
+private:
+    VkShaderModule loadModule(const std::string& path) {
+        MappedFile file(path);
+        const size_t size = file.getSize();
+
+        if (size == 0 || size % sizeof(uint32_t) != 0) {
+            throw std::runtime_error(path + " is not SPIR-V, its size isn't a multiple of 4 bytes");
+        }
+
+        // mappings start on a page boundary, the check only matters if that ever changes
+        const uint32_t* code = static_cast<const uint32_t*>(file.getData());
+        std::vector<uint32_t> alignedCode;
+        if (reinterpret_cast<uintptr_t>(code) % alignof(uint32_t) != 0) {
+            alignedCode.resize(size / sizeof(uint32_t));
+            memcpy(alignedCode.data(), file.getData(), size);
+            code = alignedCode.data();
+        }
+
+        if (code[0] != SPIRV_MAGIC) {
+            throw std::runtime_error(path + " is not SPIR-V, wrong magic number");
+        }
+
+        uint64_t hash = hashCode(code, size);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            VkShaderModule found = findModule(hash, code, size);
+            if (found != VK_NULL_HANDLE) {
+                return found;
+            }
+        }
+
+        VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+        shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        shaderModuleCreateInfo.codeSize = size;
+        shaderModuleCreateInfo.pCode = code;
+
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shader module " + path);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        VkShaderModule found = findModule(hash, code, size);
+        if (found != VK_NULL_HANDLE) {
+            // another file with the same contents finished first
+            vkDestroyShaderModule(device, shaderModule, nullptr);
+            return found;
+        }
+        modules.emplace(hash, Module{std::vector<uint32_t>(code, code + size / sizeof(uint32_t)), shaderModule});
+        return shaderModule;
+    }
+
+    // the module created from exactly this code, the hash only narrows the search, called with the mutex held
+    VkShaderModule findModule(uint64_t hash, const uint32_t* code, size_t size) const {
+        auto range = modules.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            const std::vector<uint32_t>& moduleCode = it->second.code;
+            if (moduleCode.size() * sizeof(uint32_t) == size && memcmp(moduleCode.data(), code, size) == 0) {
+                return it->second.module;
+            }
+        }
+        return VK_NULL_HANDLE;
+    }
+
+    // FNV-1a's xor and multiply applied to 32 bit words instead of bytes, a quarter of the steps over
+    // SPIR-V, which is made of words anyway. not FNV-1a proper, matches are confirmed by findModule.
+    static uint64_t hashCode(const uint32_t* code, size_t size) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size / sizeof(uint32_t); ++i) {
+            hash = (hash ^ code[i]) * 1099511628211ull;
+        }
+        return hash ^ size;
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    ThreadPool* threadPool = nullptr;
+
+    // path -> module, only touched by the thread calling load
+    std::unordered_map<std::string, std::shared_future<VkShaderModule>> files;
+
+    struct Module {
+        std::vector<uint32_t> code;
+        VkShaderModule module;
+    };
+
+    // content hash -> modules with that hash, shared with the loading threads
+    mutable std::mutex mutex;
+    std::unordered_multimap<uint64_t, Module> modules;
+};
@@ -0,0 +1,499 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "bindless-table.h"
+#include "memory-allocator.h"
+#include "ring-buffer.h"
+#include "thread-pool.h"
+
+// rgba8 pixels of every mip level of a square texture, the base level first
+struct MipChain {
+    uint32_t size = 0;
+    std::vector<uint32_t> pixels;
+    // index of the first pixel of each level
+    std::vector<size_t> levelOffsets;
+
+    uint32_t getLevelCount() const {
+        return static_cast<uint32_t>(levelOffsets.size());
+    }
+
+    uint32_t getLevelSize(uint32_t level) const {
+        return std::max(size >> level, 1u);
+    }
+
+    VkDeviceSize getLevelBytes(uint32_t level) const {
+        VkDeviceSize levelSize = getLevelSize(level);
+        return levelSize * levelSize * sizeof(uint32_t);
+    }
+
+    // levels from firstLevel down to 1x1
+    VkDeviceSize getBytes(uint32_t firstLevel) const {
+        VkDeviceSize bytes = 0;
+        for (uint32_t level = firstLevel; level < getLevelCount(); ++level) {
+            bytes += getLevelBytes(level);
+        }
+        return bytes;
+    }
+
+    // the finest level that is no larger than size
+    uint32_t getFirstLevelWithin(uint32_t levelSize) const {
+        uint32_t level = 0;
+        while (level + 1 < getLevelCount() && getLevelSize(level) > levelSize) {
+            ++level;
+        }
+        return level;
+    }
+
+    // box filters the base level of a power of two size down to 1x1
+    static MipChain fromBaseLevel(uint32_t size, std::vector<uint32_t> basePixels) {
+        if (size == 0 || (size & (size - 1)) != 0 || basePixels.size() != static_cast<size_t>(size) * size) {
+            throw std::runtime_error("mip chains need a square power of two base level");
+        }
+
+        MipChain chain;
+        chain.size = size;
+        chain.pixels = std::move(basePixels);
+        chain.levelOffsets.push_back(0);
+        for (uint32_t levelSize = size / 2; levelSize > 0; levelSize /= 2) {
+            const size_t source = chain.levelOffsets.back();
+            const size_t destination = chain.pixels.size();
+            const uint32_t sourceSize = levelSize * 2;
+            chain.levelOffsets.push_back(destination);
+            chain.pixels.resize(destination + static_cast<size_t>(levelSize) * levelSize);
+            for (uint32_t y = 0; y < levelSize; ++y) {
+                for (uint32_t x = 0; x < levelSize; ++x) {
+                    const uint32_t* row0 = &chain.pixels[source + static_cast<size_t>(y * 2) * sourceSize + x * 2];
+                    const uint32_t* row1 = row0 + sourceSize;
+                    uint32_t pixel = 0;
+                    for (uint32_t shift = 0; shift < 32; shift += 8) {
+                        uint32_t sum = (row0[0] >> shift & 0xff) + (row0[1] >> shift & 0xff) + (row1[0] >> shift & 0xff) + (row1[1] >> shift & 0xff);
+                        pixel |= ((sum + 2) / 4) << shift;
+                    }
+                    chain.pixels[destination + static_cast<size_t>(y) * levelSize + x] = pixel;
+                }
+            }
+        }
+        return chain;
+    }
+};
+
+// Keeps a window of the mip chain of every texture in device memory. Textures are loaded on the thread pool,
+// their smallest levels are uploaded together as soon as they are loaded, finer levels follow one at a time
+// while the per frame upload limit and the memory budget allow, and the finest levels of the least needed
+// textures are evicted when over budget. The resident levels of a texture are one image, a change of
+// residency creates an image with the new levels, copies the levels both images have on the gpu and uploads
+// the rest from a staging ring. The old image and its bindless slot are freed once the frame that copied
+// from it has completed. Not thread safe.
+class TextureStreamer {
+public:
+    // levels of at most this size are only uploaded together
+    static constexpr uint32_t TAIL_SIZE = 32;
+
+    struct Stats {
+        uint32_t textureCount = 0;
+        uint32_t loadedCount = 0;
+        // textures with at least their tail resident, the others sample the default texture
+        uint32_t residentCount = 0;
+        // textures with every level they are wanted at resident
+        uint32_t completeCount = 0;
+        // includes images that were replaced but may still be read by frames in flight
+        VkDeviceSize residentBytes = 0;
+        VkDeviceSize peakResidentBytes = 0;
+        uint64_t uploadedBytes = 0;
+        uint32_t evictedLevels = 0;
+    };
+
+    // uploadBytesPerFrame must fit the base level of the largest texture
+    void init(VkDevice device, MemoryAllocator& allocator, ThreadPool& threadPool, BindlessTable& table, VkDeviceSize uploadBytesPerFrame, uint32_t framesInFlight) {
+        this->device = device;
+        this->allocator = &allocator;
+        this->threadPool = &threadPool;
+        this->table = &table;
+        this->uploadBytesPerFrame = uploadBytesPerFrame;
+
+        // one frame being written, the ones in flight being read, and slack for alignment and wrapping
+        VkDeviceSize size = uploadBytesPerFrame * (framesInFlight + 2);
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = size;
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture staging buffer");
+        }
+        stagingAllocation = allocator.allocateBuffer(stagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        staging.init(stagingBuffer, size, stagingAllocation.mapped);
+
+        // sampled until a texture's tail is resident
+        defaultTexture.chain = MipChain::fromBaseLevel(1, {0xffffffff});
+        defaultTexture.loaded = true;
+        defaultTexture.residentLevel = 1;
+    }
+
+    // the device must be idle
+    void destroy() {
+        retire(std::numeric_limits<uint64_t>::max());
+        for (Texture& texture : textures) {
+            if (texture.loading.valid()) {
+                texture.loading.wait();
+            }
+            destroyImage(texture.image, texture.view, texture.allocation);
+        }
+        destroyImage(defaultTexture.image, defaultTexture.view, defaultTexture.allocation);
+        textures.clear();
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        allocator->free(stagingAllocation);
+    }
+
+    // starts loading on the thread pool, returns the texture's index
+    uint32_t add(std::function<MipChain()> load) {
+        textures.emplace_back();
+        Texture& texture = textures.back();
+        texture.loading = threadPool->submit(std::move(load));
+        ++stats.textureCount;
+        return static_cast<uint32_t>(textures.size() - 1);
+    }
+
+    // texels across the texture the way it is drawn at the moment, levels finer than the first one at least
+    // that large aren't kept
+    void setDemand(uint32_t textureIndex, float texels) {
+        textures[textureIndex].demand = texels;
+    }
+
+    // evictions start once the resident images need more
+    void setBudget(VkDeviceSize bytes) {
+        budget = bytes;
+    }
+
+    VkDeviceSize getBudget() const {
+        return budget;
+    }
+
+    // bytes of the current images of every texture, without the replaced ones still in flight
+    VkDeviceSize getCommittedBytes() const {
+        return committedBytes;
+    }
+
+    // bindless image slot to sample the texture with this frame
+    uint32_t getSlot(uint32_t textureIndex) const {
+        const Texture& texture = textures[textureIndex];
+        return texture.image != VK_NULL_HANDLE ? texture.slot : defaultTexture.slot;
+    }
+
+    uint32_t getTextureCount() const {
+        return static_cast<uint32_t>(textures.size());
+    }
+
+    const Stats& getStats() const {
+        return stats;
+    }
+
+    // true once every texture is loaded and resident at its demand
+    bool isComplete() const {
+        return stats.completeCount == stats.textureCount;
+    }
+
+    // records the frame's uploads, copies and evictions into commandBuffer ahead of any draw sampling the
+    // textures, frameNumber is the number the frame is submitted as
+    void update(VkCommandBuffer commandBuffer, uint64_t frameNumber) {
+        VkDeviceSize uploadBytes = 0;
+        if (defaultTexture.image == VK_NULL_HANDLE) {
+            uploadBytes += setResidency(defaultTexture, 0, commandBuffer, frameNumber);
+        }
+
+        for (Texture& texture : textures) {
+            if (!texture.loaded && texture.loading.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                // rethrows errors of the load on this thread
+                texture.chain = texture.loading.get();
+                texture.residentLevel = texture.chain.getLevelCount();
+                texture.loaded = true;
+                ++stats.loadedCount;
+            }
+        }
+
+        // lowest levels first, a texture is only sampled once its tail is resident
+        for (Texture& texture : textures) {
+            if (!texture.loaded || texture.image != VK_NULL_HANDLE) {
+                continue;
+            }
+            const uint32_t tailLevel = texture.chain.getFirstLevelWithin(TAIL_SIZE);
+            if (uploadBytes + texture.chain.getBytes(tailLevel) > uploadBytesPerFrame) {
+                break;
+            }
+            uploadBytes += setResidency(texture, tailLevel, commandBuffer, frameNumber);
+            ++stats.residentCount;
+        }
+
+        evict(commandBuffer, frameNumber);
+
+        // one level at a time, the textures furthest from their demand first
+        std::vector<Texture*> wanted;
+        for (Texture& texture : textures) {
+            if (texture.image != VK_NULL_HANDLE && texture.residentLevel > getDemandLevel(texture)) {
+                wanted.push_back(&texture);
+            }
+        }
+        std::sort(wanted.begin(), wanted.end(), [this](const Texture* a, const Texture* b) {
+            return a->residentLevel - getDemandLevel(*a) > b->residentLevel - getDemandLevel(*b);
+        });
+        for (Texture* texture : wanted) {
+            const uint32_t level = texture->residentLevel - 1;
+            const VkDeviceSize levelBytes = texture->chain.getLevelBytes(level);
+            if (uploadBytes + levelBytes > uploadBytesPerFrame) {
+                break;
+            }
+            if (committedBytes + levelBytes > budget) {
+                continue;
+            }
+            uploadBytes += setResidency(*texture, level, commandBuffer, frameNumber);
+        }
+
+        stats.completeCount = 0;
+        for (const Texture& texture : textures) {
+            if (texture.image != VK_NULL_HANDLE && texture.residentLevel <= getDemandLevel(texture)) {
+                ++stats.completeCount;
+            }
+        }
+        stats.uploadedBytes += uploadBytes;
+        staging.finishFrame(frameNumber);
+    }
+
+    // frees staging space, replaced images and their slots of every frame up to and including completedFrame
+    void retire(uint64_t completedFrame) {
+        while (!retired.empty() && retired.front().frameNumber <= completedFrame) {
+            RetiredImage& image = retired.front();
+            stats.residentBytes -= image.allocation.size;
+            destroyImage(image.image, image.view, image.allocation);
+            table->releaseImage(image.slot);
+            retired.pop_front();
+        }
+        staging.retire(completedFrame);
+    }
+
+private:
+    static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+    static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+    struct Texture {
+        std::future<MipChain> loading;
+        MipChain chain;
+        bool loaded = false;
+        // the finest level in the image, the level count while nothing is resident
+        uint32_t residentLevel = 0;
+        float demand = 0.0f;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        Allocation allocation;
+        uint32_t slot = 0;
+    };
+
+    struct RetiredImage {
+        // the last frame that reads the image
+        uint64_t frameNumber;
+        VkImage image;
+        VkImageView view;
+        Allocation allocation;
+        uint32_t slot;
+    };
+
+    uint32_t getDemandLevel(const Texture& texture) const {
+        const uint32_t tailLevel = texture.chain.getFirstLevelWithin(TAIL_SIZE);
+        if (texture.demand <= 0.0f) {
+            return tailLevel;
+        }
+        float level = std::floor(std::log2(texture.chain.size / texture.demand));
+        return std::min(static_cast<uint32_t>(std::max(level, 0.0f)), tailLevel);
+    }
+
+    // drops the finest level of textures resident beyond their demand, then of the ones with the largest
+    // resident level, until the images fit the budget again
+    void evict(VkCommandBuffer commandBuffer, uint64_t frameNumber) {
+        while (committedBytes > budget) {
+            Texture* victim = nullptr;
+            bool victimUnneeded = false;
+            for (Texture& texture : textures) {
+                if (texture.image == VK_NULL_HANDLE || texture.residentLevel >= texture.chain.getFirstLevelWithin(TAIL_SIZE)) {
+                    continue;
+                }
+                bool unneeded = texture.residentLevel < getDemandLevel(texture);
+                if (victim == nullptr || unneeded > victimUnneeded
+                    || (unneeded == victimUnneeded && texture.residentLevel < victim->residentLevel)) {
+                    victim = &texture;
+                    victimUnneeded = unneeded;
+                }
+            }
+            if (victim == nullptr) {
+                // only tails left, they are never evicted
+                return;
+            }
+            setResidency(*victim, victim->residentLevel + 1, commandBuffer, frameNumber);
+            ++stats.evictedLevels;
+        }
+    }
+
+    // replaces the texture's image by one holding the levels from firstLevel, returns the bytes uploaded
+    VkDeviceSize setResidency(Texture& texture, uint32_t firstLevel, VkCommandBuffer commandBuffer, uint64_t frameNumber) {
+        const MipChain& chain = texture.chain;
+        const uint32_t levelCount = chain.getLevelCount() - firstLevel;
+        const uint32_t size = chain.getLevelSize(firstLevel);
+
+        VkImageCreateInfo imageCreateInfo = {};
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = FORMAT;
+        imageCreateInfo.extent = {size, size, 1};
+        imageCreateInfo.mipLevels = levelCount;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // the source of the copy when the residency changes again
+        imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage image;
+        if (vkCreateImage(device, &imageCreateInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image");
+        }
+        Allocation allocation = allocator->allocateImage(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkImageViewCreateInfo imageViewCreateInfo = {};
+        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        imageViewCreateInfo.image = image;
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.format = FORMAT;
+        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageViewCreateInfo.subresourceRange.levelCount = levelCount;
+        imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+        VkImageView view;
+        if (vkCreateImageView(device, &imageViewCreateInfo, nullptr, &view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image view");
+        }
+
+        // earlier frames sample the old image, the layout change has to wait for them
+        std::vector<VkImageMemoryBarrier> barriers(texture.image != VK_NULL_HANDLE ? 2 : 1);
+        barriers[0] = createBarrier(image, levelCount, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        if (texture.image != VK_NULL_HANDLE) {
+            barriers[1] = createBarrier(texture.image, chain.getLevelCount() - texture.residentLevel, 0, VK_ACCESS_TRANSFER_READ_BIT,
+                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, barriers.size(), barriers.data());
+
+        // levels the old image has are copied on the gpu
+        std::vector<VkImageCopy> copies;
+        for (uint32_t level = std::max(firstLevel, texture.residentLevel); level < chain.getLevelCount(); ++level) {
+            const uint32_t levelSize = chain.getLevelSize(level);
+            VkImageCopy copy = {};
+            copy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - texture.residentLevel, 0, 1};
+            copy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - firstLevel, 0, 1};
+            copy.extent = {levelSize, levelSize, 1};
+            copies.push_back(copy);
+        }
+        if (!copies.empty()) {
+            vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copies.size(), copies.data());
+        }
+
+        // the rest comes from the staging ring
+        const uint32_t uploadEnd = std::min(texture.residentLevel, chain.getLevelCount());
+        VkDeviceSize uploadBytes = 0;
+        for (uint32_t level = firstLevel; level < uploadEnd; ++level) {
+            uploadBytes += alignUp(chain.getLevelBytes(level), STAGING_ALIGNMENT);
+        }
+        if (uploadBytes > 0) {
+            RingBuffer::Region region = staging.allocate(uploadBytes, STAGING_ALIGNMENT);
+            std::vector<VkBufferImageCopy> uploads;
+            VkDeviceSize offset = 0;
+            for (uint32_t level = firstLevel; level < uploadEnd; ++level) {
+                const uint32_t levelSize = chain.getLevelSize(level);
+                memcpy(static_cast<char*>(region.data) + offset, &chain.pixels[chain.levelOffsets[level]], chain.getLevelBytes(level));
+
+                VkBufferImageCopy upload = {};
+                upload.bufferOffset = region.offset + offset;
+                upload.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - firstLevel, 0, 1};
+                upload.imageExtent = {levelSize, levelSize, 1};
+                uploads.push_back(upload);
+                offset += alignUp(chain.getLevelBytes(level), STAGING_ALIGNMENT);
+            }
+            vkCmdCopyBufferToImage(commandBuffer, region.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uploads.size(), uploads.data());
+        }
+
+        VkImageMemoryBarrier readBarrier = createBarrier(image, levelCount, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &readBarrier);
+
+        if (texture.image != VK_NULL_HANDLE) {
+            // read by the copy above, so it lives until this frame has completed
+            retired.push_back({frameNumber, texture.image, texture.view, texture.allocation, texture.slot});
+            committedBytes -= texture.allocation.size;
+        }
+        texture.image = image;
+        texture.view = view;
+        texture.allocation = allocation;
+        texture.slot = table->addImage(view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        texture.residentLevel = firstLevel;
+
+        committedBytes += allocation.size;
+        stats.residentBytes += allocation.size;
+        stats.peakResidentBytes = std::max(stats.peakResidentBytes, stats.residentBytes);
+        return uploadBytes;
+    }
+
+    static VkImageMemoryBarrier createBarrier(VkImage image, uint32_t levelCount, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+                                              VkImageLayout oldLayout, VkImageLayout newLayout) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccessMask;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+        return barrier;
+    }
+
+    void destroyImage(VkImage image, VkImageView view, Allocation& allocation) {
+        vkDestroyImageView(device, view, nullptr);
+        vkDestroyImage(device, image, nullptr);
+        allocator->free(allocation);
+    }
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    ThreadPool* threadPool = nullptr;
+    BindlessTable* table = nullptr;
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    Allocation stagingAllocation;
+    RingBuffer staging;
+    VkDeviceSize uploadBytesPerFrame = 0;
+
+    Texture defaultTexture;
+    std::vector<Texture> textures;
+    std::deque<RetiredImage> retired;
+    VkDeviceSize budget = std::numeric_limits<VkDeviceSize>::max();
+    VkDeviceSize committedBytes = 0;
+    Stats stats;
+};
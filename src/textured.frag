@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// hello-triangle.frag modulated by a texture from the bindless table, used with bindless.vert
+
+layout(location = 0) in vec3 vertexColor;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) flat in uint textureSlot;
+
+layout(location = 0) out vec4 outColor;
+
+// every sampled image in the bindless table and its immutable sampler, see bindless-table.h
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 2) uniform sampler textureSampler;
+
+void main() {
+    // instances of a draw may sample different textures
+    vec4 texel = texture(sampler2D(textures[nonuniformEXT(textureSlot)], textureSampler), texCoord);
+    outColor = vec4(vertexColor * texel.rgb, 1.0);
+}
@@ -0,0 +1,351 @@
+#include "vertex-kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VERTEX_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// gcc and clang only emit avx2 instructions in functions that ask for them, msvc always does
+#if defined(VERTEX_KERNELS_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+
+uint32_t packColor(float r, float g, float b, float a) {
+    auto unorm8 = [](float value) {
+        return static_cast<uint32_t>(std::nearbyint(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+    };
+    return unorm8(r) | unorm8(g) << 8 | unorm8(b) << 16 | unorm8(a) << 24;
+}
+
+int16_t packSnorm16(float value) {
+    return static_cast<int16_t>(std::nearbyint(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+void packScalar(const VertexStream& stream, const Transform2D& t, size_t begin, PackedVertex* out) {
+    for (size_t i = begin; i < stream.size(); ++i) {
+        out[i].x = t.m00 * stream.x[i] + t.m01 * stream.y[i] + t.tx;
+        out[i].y = t.m10 * stream.x[i] + t.m11 * stream.y[i] + t.ty;
+        out[i].color = packColor(stream.r[i], stream.g[i], stream.b[i], stream.a[i]);
+    }
+}
+
+void packScalar(const VertexStream& stream, const Transform2D& t, size_t begin, HalfVertex* out) {
+    for (size_t i = begin; i < stream.size(); ++i) {
+        out[i].x = floatToHalf(t.m00 * stream.x[i] + t.m01 * stream.y[i] + t.tx);
+        out[i].y = floatToHalf(t.m10 * stream.x[i] + t.m11 * stream.y[i] + t.ty);
+        out[i].color = packColor(stream.r[i], stream.g[i], stream.b[i], stream.a[i]);
+    }
+}
+
+void packScalar(const VertexStream& stream, const Transform2D& t, size_t begin, SnormVertex* out) {
+    for (size_t i = begin; i < stream.size(); ++i) {
+        out[i].x = packSnorm16(t.m00 * stream.x[i] + t.m01 * stream.y[i] + t.tx);
+        out[i].y = packSnorm16(t.m10 * stream.x[i] + t.m11 * stream.y[i] + t.ty);
+        out[i].color = packColor(stream.r[i], stream.g[i], stream.b[i], stream.a[i]);
+    }
+}
+
+#ifdef VERTEX_KERNELS_X86
+
+__m128i packColorsSse2(__m128 r, __m128 g, __m128 b, __m128 a) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    // converts with the current rounding mode, round to nearest even like the scalar path
+    __m128i r8 = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(r, zero), one), scale));
+    __m128i g8 = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(g, zero), one), scale));
+    __m128i b8 = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(b, zero), one), scale));
+    __m128i a8 = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(a, zero), one), scale));
+    return _mm_or_si128(_mm_or_si128(r8, _mm_slli_epi32(g8, 8)), _mm_or_si128(_mm_slli_epi32(b8, 16), _mm_slli_epi32(a8, 24)));
+}
+
+// four vertices from x, y and color lanes to 48 bytes of x y c x y c ...
+void storePackedSse2(__m128 x, __m128 y, __m128i colors, PackedVertex* out) {
+    __m128 c = _mm_castsi128_ps(colors);
+    __m128 xyLow = _mm_unpacklo_ps(x, y);
+    __m128 xyHigh = _mm_unpackhi_ps(x, y);
+
+    __m128 c0x1 = _mm_shuffle_ps(c, xyLow, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128 out0 = _mm_shuffle_ps(xyLow, c0x1, _MM_SHUFFLE(2, 0, 1, 0));
+    __m128 y1c1 = _mm_shuffle_ps(xyLow, c, _MM_SHUFFLE(1, 1, 3, 3));
+    __m128 out1 = _mm_shuffle_ps(y1c1, xyHigh, _MM_SHUFFLE(1, 0, 2, 0));
+    __m128 c2x3 = _mm_shuffle_ps(c, xyHigh, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 y3c3 = _mm_shuffle_ps(xyHigh, c, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 out2 = _mm_shuffle_ps(c2x3, y3c3, _MM_SHUFFLE(2, 0, 2, 0));
+
+    float* destination = reinterpret_cast<float*>(out);
+    _mm_storeu_ps(destination, out0);
+    _mm_storeu_ps(destination + 4, out1);
+    _mm_storeu_ps(destination + 8, out2);
+}
+
+void packSse2(const VertexStream& stream, const Transform2D& t, PackedVertex* out) {
+    const __m128 m00 = _mm_set1_ps(t.m00), m01 = _mm_set1_ps(t.m01), tx = _mm_set1_ps(t.tx);
+    const __m128 m10 = _mm_set1_ps(t.m10), m11 = _mm_set1_ps(t.m11), ty = _mm_set1_ps(t.ty);
+
+    size_t i = 0;
+    for (; i + 4 <= stream.size(); i += 4) {
+        __m128 x = _mm_loadu_ps(&stream.x[i]);
+        __m128 y = _mm_loadu_ps(&stream.y[i]);
+        __m128 transformedX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m01, y)), tx);
+        __m128 transformedY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, x), _mm_mul_ps(m11, y)), ty);
+        __m128i colors = packColorsSse2(_mm_loadu_ps(&stream.r[i]), _mm_loadu_ps(&stream.g[i]), _mm_loadu_ps(&stream.b[i]), _mm_loadu_ps(&stream.a[i]));
+        storePackedSse2(transformedX, transformedY, colors, out + i);
+    }
+    packScalar(stream, t, i, out);
+}
+
+__m128i packSnormSse2(__m128 value) {
+    return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f)), _mm_set1_ps(32767.0f)));
+}
+
+void packSse2(const VertexStream& stream, const Transform2D& t, SnormVertex* out) {
+    const __m128 m00 = _mm_set1_ps(t.m00), m01 = _mm_set1_ps(t.m01), tx = _mm_set1_ps(t.tx);
+    const __m128 m10 = _mm_set1_ps(t.m10), m11 = _mm_set1_ps(t.m11), ty = _mm_set1_ps(t.ty);
+
+    size_t i = 0;
+    for (; i + 4 <= stream.size(); i += 4) {
+        __m128 x = _mm_loadu_ps(&stream.x[i]);
+        __m128 y = _mm_loadu_ps(&stream.y[i]);
+        __m128i snormX = packSnormSse2(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m01, y)), tx));
+        __m128i snormY = packSnormSse2(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, x), _mm_mul_ps(m11, y)), ty));
+        __m128i colors = packColorsSse2(_mm_loadu_ps(&stream.r[i]), _mm_loadu_ps(&stream.g[i]), _mm_loadu_ps(&stream.b[i]), _mm_loadu_ps(&stream.a[i]));
+
+        // already clamped, the saturation never kicks in
+        __m128i xy = _mm_unpacklo_epi16(_mm_packs_epi32(snormX, snormX), _mm_packs_epi32(snormY, snormY));
+        __m128i* destination = reinterpret_cast<__m128i*>(out + i);
+        _mm_storeu_si128(destination, _mm_unpacklo_epi32(xy, colors));
+        _mm_storeu_si128(destination + 1, _mm_unpackhi_epi32(xy, colors));
+    }
+    packScalar(stream, t, i, out);
+}
+
+TARGET_AVX2 __m256i packColorsAvx2(__m256 r, __m256 g, __m256 b, __m256 a) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    __m256i r8 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(r, zero), one), scale));
+    __m256i g8 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(g, zero), one), scale));
+    __m256i b8 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(b, zero), one), scale));
+    __m256i a8 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(a, zero), one), scale));
+    return _mm256_or_si256(_mm256_or_si256(r8, _mm256_slli_epi32(g8, 8)), _mm256_or_si256(_mm256_slli_epi32(b8, 16), _mm256_slli_epi32(a8, 24)));
+}
+
+// no fma, so the results match the other levels bit for bit
+TARGET_AVX2 void transformAvx2(const VertexStream& stream, const Transform2D& t, size_t i, __m256& x, __m256& y) {
+    __m256 sourceX = _mm256_loadu_ps(&stream.x[i]);
+    __m256 sourceY = _mm256_loadu_ps(&stream.y[i]);
+    x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.m00), sourceX), _mm256_mul_ps(_mm256_set1_ps(t.m01), sourceY)), _mm256_set1_ps(t.tx));
+    y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.m10), sourceX), _mm256_mul_ps(_mm256_set1_ps(t.m11), sourceY)), _mm256_set1_ps(t.ty));
+}
+
+TARGET_AVX2 void packAvx2(const VertexStream& stream, const Transform2D& t, PackedVertex* out) {
+    size_t i = 0;
+    for (; i + 8 <= stream.size(); i += 8) {
+        __m256 x, y;
+        transformAvx2(stream, t, i, x, y);
+        __m256i colors = packColorsAvx2(_mm256_loadu_ps(&stream.r[i]), _mm256_loadu_ps(&stream.g[i]), _mm256_loadu_ps(&stream.b[i]), _mm256_loadu_ps(&stream.a[i]));
+        // the 12 byte stride doesn't map onto 256 bit lanes, interleave each half like four vertices
+        storePackedSse2(_mm256_castps256_ps128(x), _mm256_castps256_ps128(y), _mm256_castsi256_si128(colors), out + i);
+        storePackedSse2(_mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1), _mm256_extracti128_si256(colors, 1), out + i + 4);
+    }
+    packScalar(stream, t, i, out);
+}
+
+TARGET_AVX2 void packAvx2(const VertexStream& stream, const Transform2D& t, HalfVertex* out) {
+    size_t i = 0;
+    for (; i + 8 <= stream.size(); i += 8) {
+        __m256 x, y;
+        transformAvx2(stream, t, i, x, y);
+        __m256i colors = packColorsAvx2(_mm256_loadu_ps(&stream.r[i]), _mm256_loadu_ps(&stream.g[i]), _mm256_loadu_ps(&stream.b[i]), _mm256_loadu_ps(&stream.a[i]));
+
+        __m128i halfX = _mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT);
+        __m128i halfY = _mm256_cvtps_ph(y, _MM_FROUND_TO_NEAREST_INT);
+        // 32 bit x y pairs, then paired with the colors into 8 byte vertices
+        __m128i xyLow = _mm_unpacklo_epi16(halfX, halfY);
+        __m128i xyHigh = _mm_unpackhi_epi16(halfX, halfY);
+        __m128i colorsLow = _mm256_castsi256_si128(colors);
+        __m128i colorsHigh = _mm256_extracti128_si256(colors, 1);
+
+        __m128i* destination = reinterpret_cast<__m128i*>(out + i);
+        _mm_storeu_si128(destination, _mm_unpacklo_epi32(xyLow, colorsLow));
+        _mm_storeu_si128(destination + 1, _mm_unpackhi_epi32(xyLow, colorsLow));
+        _mm_storeu_si128(destination + 2, _mm_unpacklo_epi32(xyHigh, colorsHigh));
+        _mm_storeu_si128(destination + 3, _mm_unpackhi_epi32(xyHigh, colorsHigh));
+    }
+    packScalar(stream, t, i, out);
+}
+
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4]) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i) {
+        registers[i] = static_cast<uint32_t>(info[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+uint64_t xgetbv() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t low, high;
+    __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+}
+
+SimdLevel querySimdLevel() {
+    uint32_t registers[4];
+    cpuid(0, 0, registers);
+    const uint32_t maxLeaf = registers[0];
+
+    cpuid(1, 0, registers);
+    const bool sse2 = registers[3] & (1u << 26);
+    const bool osxsave = registers[2] & (1u << 27);
+    const bool avx = registers[2] & (1u << 28);
+    const bool f16c = registers[2] & (1u << 29);
+
+    bool avx2 = false;
+    if (maxLeaf >= 7) {
+        cpuid(7, 0, registers);
+        avx2 = registers[1] & (1u << 5);
+    }
+    // the os has to save the ymm registers on context switches
+    const bool ymmEnabled = osxsave && (xgetbv() & 0x6) == 0x6;
+
+    if (avx && avx2 && f16c && ymmEnabled) {
+        return SimdLevel::Avx2;
+    }
+    return sse2 ? SimdLevel::Sse2 : SimdLevel::Scalar;
+}
+
+#else
+
+SimdLevel querySimdLevel() {
+    return SimdLevel::Scalar;
+}
+
+#endif
+
+} // namespace
+
+SimdLevel detectSimdLevel() {
+    static const SimdLevel level = querySimdLevel();
+    return level;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::Sse2:
+        return "sse2";
+    case SimdLevel::Avx2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+void packVertices(const VertexStream& stream, const Transform2D& transform, PackedVertex* out, SimdLevel level) {
+#ifdef VERTEX_KERNELS_X86
+    switch (level) {
+    case SimdLevel::Avx2:
+        packAvx2(stream, transform, out);
+        return;
+    case SimdLevel::Sse2:
+        packSse2(stream, transform, out);
+        return;
+    case SimdLevel::Scalar:
+        break;
+    }
+#else
+    (void)level;
+#endif
+    packScalar(stream, transform, 0, out);
+}
+
+void packVertices(const VertexStream& stream, const Transform2D& transform, HalfVertex* out, SimdLevel level) {
+#ifdef VERTEX_KERNELS_X86
+    // without F16C the sse2 level has no fast half conversion
+    if (level == SimdLevel::Avx2) {
+        packAvx2(stream, transform, out);
+        return;
+    }
+#else
+    (void)level;
+#endif
+    packScalar(stream, transform, 0, out);
+}
+
+void packVertices(const VertexStream& stream, const Transform2D& transform, SnormVertex* out, SimdLevel level) {
+#ifdef VERTEX_KERNELS_X86
+    // sse2 already keeps up with memory bandwidth at 8 bytes per vertex
+    if (level != SimdLevel::Scalar) {
+        packSse2(stream, transform, out);
+        return;
+    }
+#else
+    (void)level;
+#endif
+    packScalar(stream, transform, 0, out);
+}
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff) {
+        // infinity stays infinity, nan stays a quiet nan
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+    }
+
+    const int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 0x1f) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+
+    if (halfExponent <= 0) {
+        // denormal or zero
+        if (halfExponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        const uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t halfMantissa = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1))) {
+            ++halfMantissa;
+        }
+        return static_cast<uint16_t>(sign | halfMantissa);
+    }
+
+    uint32_t half = sign | static_cast<uint32_t>(halfExponent) << 10 | mantissa >> 13;
+    const uint32_t remainder = mantissa & 0x1fff;
+    // a carry out of the mantissa correctly bumps the exponent, up to infinity
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return static_cast<uint16_t>(half);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Structure of arrays staging for cpu generated vertices, every attribute component is contiguous
+// so kernels can load several vertices per instruction.
+struct VertexStream {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> r;
+    std::vector<float> g;
+    std::vector<float> b;
+    std::vector<float> a;
+
+    size_t size() const {
+        return x.size();
+    }
+
+    void resize(size_t count) {
+        x.resize(count);
+        y.resize(count);
+        r.resize(count);
+        g.resize(count);
+        b.resize(count);
+        a.resize(count);
+    }
+};
+
+// 2d affine transform, x' = m00 * x + m01 * y + tx
+struct Transform2D {
+    float m00 = 1.0f;
+    float m01 = 0.0f;
+    float m10 = 0.0f;
+    float m11 = 1.0f;
+    float tx = 0.0f;
+    float ty = 0.0f;
+};
+
+// gpu layouts the kernels interleave into, colors are R8G8B8A8_UNORM
+struct PackedVertex {
+    float x;
+    float y;
+    uint32_t color;
+};
+
+// positions as R16G16_SFLOAT
+struct HalfVertex {
+    uint16_t x;
+    uint16_t y;
+    uint32_t color;
+};
+
+// positions as R16G16_SNORM, clamped to [-1, 1]
+struct SnormVertex {
+    int16_t x;
+    int16_t y;
+    uint32_t color;
+};
+
+enum class SimdLevel {
+    Scalar,
+    Sse2,
+    // also requires F16C for the half float conversions
+    Avx2
+};
+
+// best level supported by the cpu and os, detected once
+SimdLevel detectSimdLevel();
+
+const char* simdLevelName(SimdLevel level);
+
+// transform positions, pack colors and interleave into out in one pass, out must hold stream.size() vertices
+void packVertices(const VertexStream& stream, const Transform2D& transform, PackedVertex* out, SimdLevel level = detectSimdLevel());
+void packVertices(const VertexStream& stream, const Transform2D& transform, HalfVertex* out, SimdLevel level = detectSimdLevel());
+void packVertices(const VertexStream& stream, const Transform2D& transform, SnormVertex* out, SimdLevel level = detectSimdLevel());
+
+// round to nearest even, like F16C
+uint16_t floatToHalf(float value);
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include "vertex-kernels.h"
+
+// vertex buffer layouts the mesh and streamed vertices can be stored in, colors are always 4 channels
+enum class VertexFormat {
+    // R32G32_SFLOAT position, R32G32B32_SFLOAT color
+    Float,
+    // R32G32_SFLOAT position, R8G8B8A8_UNORM color
+    Packed,
+    // R16G16_SFLOAT position, R8G8B8A8_UNORM color
+    Half,
+    // R16G16_SNORM position, R8G8B8A8_UNORM color, positions must be within [-1, 1]
+    Snorm
+};
+
+inline const char* vertexFormatName(VertexFormat format) {
+    switch (format) {
+    case VertexFormat::Float:
+        return "float";
+    case VertexFormat::Packed:
+        return "packed";
+    case VertexFormat::Half:
+        return "half";
+    case VertexFormat::Snorm:
+        return "snorm";
+    }
+    return "unknown";
+}
+
+// the layout meshes are imported and processed in, converted to a VertexFormat for the gpu
+struct Vertex {
+    glm::vec2 position;
+    glm::vec3 color;
+};
+
+inline void copyToVertexStream(const Vertex* source, size_t count, VertexStream& stream) {
+    stream.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        stream.x[i] = source[i].position.x;
+        stream.y[i] = source[i].position.y;
+        stream.r[i] = source[i].color.x;
+        stream.g[i] = source[i].color.y;
+        stream.b[i] = source[i].color.z;
+        stream.a[i] = 1.0f;
+    }
+}
+
+inline void packVertexStream(const VertexStream& stream, Vertex* out) {
+    for (size_t i = 0; i < stream.size(); ++i) {
+        out[i] = {{stream.x[i], stream.y[i]}, {stream.r[i], stream.g[i], stream.b[i]}};
+    }
+}
+
+template<typename GpuVertex>
+void packVertexStream(const VertexStream& stream, GpuVertex* out) {
+    packVertices(stream, Transform2D(), out);
+}
+
+struct VertexAttribute {
+    VkFormat format;
+    uint32_t offset;
+};
+
+// How the shader reads a vertex struct. Specializations list the attributes in location order, and the
+// pipeline's vertex input state is generated from them instead of written by hand.
+template<typename VertexType>
+struct VertexLayout;
+
+template<>
+struct VertexLayout<Vertex> {
+    static constexpr std::array<VertexAttribute, 2> attributes = {{
+        {VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, position)},
+        {VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)}
+    }};
+};
+
+template<>
+struct VertexLayout<PackedVertex> {
+    static constexpr std::array<VertexAttribute, 2> attributes = {{
+        {VK_FORMAT_R32G32_SFLOAT, offsetof(PackedVertex, x)},
+        {VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color)}
+    }};
+};
+
+template<>
+struct VertexLayout<HalfVertex> {
+    static constexpr std::array<VertexAttribute, 2> attributes = {{
+        {VK_FORMAT_R16G16_SFLOAT, offsetof(HalfVertex, x)},
+        {VK_FORMAT_R8G8B8A8_UNORM, offsetof(HalfVertex, color)}
+    }};
+};
+
+template<>
+struct VertexLayout<SnormVertex> {
+    static constexpr std::array<VertexAttribute, 2> attributes = {{
+        {VK_FORMAT_R16G16_SNORM, offsetof(SnormVertex, x)},
+        {VK_FORMAT_R8G8B8A8_UNORM, offsetof(SnormVertex, color)}
+    }};
+};
+
+// size in bytes of the formats vertex attributes use here, 0 for anything else
+constexpr uint32_t vertexFormatSize(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R32_UINT:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        return 4;
+    case VK_FORMAT_R32G32_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+        return 12;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+// every attribute has a known format and lies inside the struct, checked at compile time
+template<typename VertexType>
+constexpr bool isValidVertexLayout() {
+    for (const VertexAttribute& attribute : VertexLayout<VertexType>::attributes) {
+        uint32_t size = vertexFormatSize(attribute.format);
+        if (size == 0 || attribute.offset + size > sizeof(VertexType)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename VertexType>
+VkVertexInputBindingDescription getVertexBindingDescription(uint32_t binding, VkVertexInputRate inputRate) {
+    static_assert(isValidVertexLayout<VertexType>(), "vertex layout doesn't match the vertex struct");
+
+    VkVertexInputBindingDescription bindingDescription = {};
+    bindingDescription.binding = binding;
+    bindingDescription.stride = sizeof(VertexType);
+    bindingDescription.inputRate = inputRate;
+    return bindingDescription;
+}
+
+// appends the attributes at consecutive locations from firstLocation, returns the next free location
+template<typename VertexType>
+uint32_t appendVertexAttributeDescriptions(uint32_t binding, uint32_t firstLocation, std::vector<VkVertexInputAttributeDescription>& descriptions) {
+    static_assert(isValidVertexLayout<VertexType>(), "vertex layout doesn't match the vertex struct");
+
+    uint32_t location = firstLocation;
+    for (const VertexAttribute& attribute : VertexLayout<VertexType>::attributes) {
+        VkVertexInputAttributeDescription description = {};
+        description.binding = binding;
+        description.location = location++;
+        description.format = attribute.format;
+        description.offset = attribute.offset;
+        descriptions.push_back(description);
+    }
+    return location;
+}